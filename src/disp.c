@@ -0,0 +1,475 @@
+/*
+ * disp.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "dmac.h"
+#include "port.h"
+#include "spi.h"
+#include "spibus.h"
+#include "i2c.h"
+#include "disp.h"
+#include <string.h>
+
+#if DISP == 1
+
+struct init_cmd {
+	uint8_t cmd;
+	uint8_t n;
+	uint8_t par[2];
+	uint8_t dly;
+};
+
+static const struct init_cmd ssd1306_init[] = {
+	{0xAE, 0, {0}, 0},
+	{0xD5, 1, {0x80}, 0},
+	{0xA8, 1, {0x3F}, 0},
+	{0xD3, 1, {0x00}, 0},
+	{0x40, 0, {0}, 0},
+	{0x8D, 1, {0x14}, 0},
+	{0x20, 1, {0x00}, 0},
+	{0xA1, 0, {0}, 0},
+	{0xC8, 0, {0}, 0},
+	{0xDA, 1, {0x12}, 0},
+	{0x81, 1, {0xCF}, 0},
+	{0xD9, 1, {0xF1}, 0},
+	{0xDB, 1, {0x40}, 0},
+	{0xA4, 0, {0}, 0},
+	{0xA6, 0, {0}, 0},
+	{0xAF, 0, {0}, 0}
+};
+
+static const struct init_cmd st7735_init[] = {
+	{0x01, 0, {0}, 150},
+	{0x11, 0, {0}, 120},
+	{0x3A, 1, {0x05}, 0},
+	{0x36, 1, {0x00}, 0},
+	{0x29, 0, {0}, 10}
+};
+
+static void disp_tsk(void *p);
+static void conf_ctrl(disp dev);
+static void add_rect(disp dev, struct disp_rect *r);
+static int flush_rect(disp dev, struct disp_rect *r);
+static int cmd(disp dev, uint8_t c, const uint8_t *par, int n);
+static int data(disp dev, const uint8_t *p, int n);
+static void begin(disp dev);
+static void end(disp dev);
+
+/**
+ * init_disp
+ */
+void init_disp(disp dev)
+{
+	if (dev->bus == DISP_BUS_SPI) {
+		if (dev->bdev == NULL || dev->dc_port == NULL) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		conf_pin(dev->dc_pin, dev->dc_port, PIN_FUNC_OUTPUT_HIGH, PIN_FEAT_END);
+	} else if (dev->bus != DISP_BUS_I2C || dev->ctrl != DISP_CTRL_SSD1306 || dev->i2c == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (pdPASS != xTaskCreate(disp_tsk, dev->tsk_nm, DISP_TASK_STACK_SIZE, dev,
+				  DISP_TASK_PRIO, &dev->tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+}
+
+/**
+ * conf_ctrl
+ *
+ * Send init sequence to controller (called by display task, sequence
+ * contains delays and blocking bus transfers).
+ */
+static void conf_ctrl(disp dev)
+{
+	const struct init_cmd *ic;
+	uint8_t par[2];
+	int n, err;
+
+	if (dev->ctrl == DISP_CTRL_SSD1306) {
+		ic = ssd1306_init;
+		n = sizeof(ssd1306_init) / sizeof(struct init_cmd);
+	} else {
+		ic = st7735_init;
+		n = sizeof(st7735_init) / sizeof(struct init_cmd);
+	}
+	for (int i = 0; i < n; i++, ic++) {
+		memcpy(par, ic->par, sizeof(par));
+		switch (ic->cmd) {
+		case 0xA8 :
+			par[0] = dev->height - 1;
+			break;
+		case 0xDA :
+			par[0] = (dev->height == 64) ? 0x12 : 0x02;
+			break;
+		case 0x36 :
+			par[0] = dev->madctl;
+			break;
+		}
+		begin(dev);
+		if ((err = cmd(dev, ic->cmd, par, ic->n))) {
+			dev->err = err;
+		}
+		end(dev);
+		if (ic->dly) {
+			vTaskDelay(ic->dly / portTICK_PERIOD_MS);
+		}
+	}
+}
+
+/**
+ * disp_mark
+ */
+void disp_mark(disp dev, int x, int y, int w, int h)
+{
+	struct disp_rect r;
+
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	if (x + w > dev->width) {
+		w = dev->width - x;
+	}
+	if (y + h > dev->height) {
+		h = dev->height - y;
+	}
+	if (w <= 0 || h <= 0) {
+		return;
+	}
+	r.x0 = x;
+	r.y0 = y;
+	r.x1 = x + w - 1;
+	r.y1 = y + h - 1;
+	if (dev->ctrl == DISP_CTRL_SSD1306) {
+		r.y0 &= ~7;
+		r.y1 |= 7;
+	}
+	add_rect(dev, &r);
+}
+
+/**
+ * disp_fill_rect
+ */
+void disp_fill_rect(disp dev, int x, int y, int w, int h, unsigned int color)
+{
+	int x1 = x + w, y1 = y + h;
+
+	if (x < 0) {
+		x = 0;
+	}
+	if (y < 0) {
+		y = 0;
+	}
+	if (x1 > dev->width) {
+		x1 = dev->width;
+	}
+	if (y1 > dev->height) {
+		y1 = dev->height;
+	}
+	for (int j = y; j < y1; j++) {
+		for (int i = x; i < x1; i++) {
+			if (dev->ctrl == DISP_CTRL_SSD1306) {
+				if (color) {
+					dev->fb[(j >> 3) * dev->width + i] |= 1 << (j & 7);
+				} else {
+					dev->fb[(j >> 3) * dev->width + i] &= ~(1 << (j & 7));
+				}
+			} else {
+				dev->fb[(j * dev->width + i) * 2] = color >> 8;
+				dev->fb[(j * dev->width + i) * 2 + 1] = color;
+			}
+		}
+	}
+	disp_mark(dev, x, y, x1 - x, y1 - y);
+}
+
+/**
+ * disp_flush
+ */
+void disp_flush(disp dev)
+{
+	xTaskNotifyGive(dev->tsk_hndl);
+}
+
+/**
+ * disp_tsk
+ */
+static void disp_tsk(void *p)
+{
+	disp dev = p;
+	struct disp_rect r[DISP_DIRTY_MAX];
+	int n, err;
+	boolean_t retry;
+
+	conf_ctrl(dev);
+	while (TRUE) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		taskENTER_CRITICAL();
+		n = dev->dirty_cnt;
+		memcpy(r, dev->dirty, n * sizeof(struct disp_rect));
+		dev->dirty_cnt = 0;
+		taskEXIT_CRITICAL();
+		if (!n) {
+			continue;
+		}
+		retry = FALSE;
+		begin(dev);
+		for (int i = 0; i < n; i++) {
+			if ((err = flush_rect(dev, &r[i]))) {
+				dev->err = err;
+				add_rect(dev, &r[i]);
+				retry = TRUE;
+			} else {
+				dev->rect_cnt++;
+			}
+		}
+		end(dev);
+		dev->flush_cnt++;
+		if (retry) {
+			// Failed rects were re-queued, flush them again later.
+			vTaskDelay(DISP_RETRY_TICKS);
+			xTaskNotifyGive(dev->tsk_hndl);
+		}
+	}
+}
+
+/**
+ * add_rect
+ */
+static void add_rect(disp dev, struct disp_rect *r)
+{
+	struct disp_rect u = *r, *d;
+	int j, g, min;
+
+	taskENTER_CRITICAL();
+	while (TRUE) {
+		for (int i = 0; i < dev->dirty_cnt; i++) {
+			d = &dev->dirty[i];
+			if (d->x0 <= u.x1 + 1 && u.x0 <= d->x1 + 1 && d->y0 <= u.y1 + 1 && u.y0 <= d->y1 + 1) {
+				u.x0 = (d->x0 < u.x0) ? d->x0 : u.x0;
+				u.y0 = (d->y0 < u.y0) ? d->y0 : u.y0;
+				u.x1 = (d->x1 > u.x1) ? d->x1 : u.x1;
+				u.y1 = (d->y1 > u.y1) ? d->y1 : u.y1;
+				*d = dev->dirty[--dev->dirty_cnt];
+				i = -1;
+			}
+		}
+		if (dev->dirty_cnt < DISP_DIRTY_MAX) {
+			break;
+		}
+		j = 0;
+		min = 0x7FFFFFFF;
+		for (int i = 0; i < dev->dirty_cnt; i++) {
+			d = &dev->dirty[i];
+			g = (((d->x1 > u.x1) ? d->x1 : u.x1) - ((d->x0 < u.x0) ? d->x0 : u.x0) + 1) *
+			    (((d->y1 > u.y1) ? d->y1 : u.y1) - ((d->y0 < u.y0) ? d->y0 : u.y0) + 1) -
+			    (d->x1 - d->x0 + 1) * (d->y1 - d->y0 + 1);
+			if (g < min) {
+				min = g;
+				j = i;
+			}
+		}
+		d = &dev->dirty[j];
+		u.x0 = (d->x0 < u.x0) ? d->x0 : u.x0;
+		u.y0 = (d->y0 < u.y0) ? d->y0 : u.y0;
+		u.x1 = (d->x1 > u.x1) ? d->x1 : u.x1;
+		u.y1 = (d->y1 > u.y1) ? d->y1 : u.y1;
+		*d = dev->dirty[--dev->dirty_cnt];
+	}
+	dev->dirty[dev->dirty_cnt++] = u;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * flush_rect
+ *
+ * Set controller window and send region. Rows of full width region are
+ * contiguous in framebuffer and are sent by single DMA transfer.
+ */
+static int flush_rect(disp dev, struct disp_rect *r)
+{
+	uint8_t par[4];
+	int w = r->x1 - r->x0 + 1, ret;
+
+	if (dev->ctrl == DISP_CTRL_SSD1306) {
+		par[0] = r->x0;
+		par[1] = r->x1;
+		if ((ret = cmd(dev, 0x21, par, 2))) {
+			return (ret);
+		}
+		par[0] = r->y0 >> 3;
+		par[1] = r->y1 >> 3;
+		if ((ret = cmd(dev, 0x22, par, 2))) {
+			return (ret);
+		}
+		if (w == dev->width) {
+			dev->byte_cnt += w * (par[1] - par[0] + 1);
+			return (data(dev, dev->fb + par[0] * dev->width, w * (par[1] - par[0] + 1)));
+		}
+		for (int p = par[0]; p <= par[1]; p++) {
+			if ((ret = data(dev, dev->fb + p * dev->width + r->x0, w))) {
+				return (ret);
+			}
+			dev->byte_cnt += w;
+		}
+		return (0);
+	}
+	par[0] = (r->x0 + dev->x_ofs) >> 8;
+	par[1] = r->x0 + dev->x_ofs;
+	par[2] = (r->x1 + dev->x_ofs) >> 8;
+	par[3] = r->x1 + dev->x_ofs;
+	if ((ret = cmd(dev, 0x2A, par, 4))) {
+		return (ret);
+	}
+	par[0] = (r->y0 + dev->y_ofs) >> 8;
+	par[1] = r->y0 + dev->y_ofs;
+	par[2] = (r->y1 + dev->y_ofs) >> 8;
+	par[3] = r->y1 + dev->y_ofs;
+	if ((ret = cmd(dev, 0x2B, par, 4)) || (ret = cmd(dev, 0x2C, NULL, 0))) {
+		return (ret);
+	}
+	if (w == dev->width) {
+		dev->byte_cnt += 2 * w * (r->y1 - r->y0 + 1);
+		return (data(dev, dev->fb + 2 * r->y0 * w, 2 * w * (r->y1 - r->y0 + 1)));
+	}
+	for (int y = r->y0; y <= r->y1; y++) {
+		if ((ret = data(dev, dev->fb + 2 * (y * dev->width + r->x0), 2 * w))) {
+			return (ret);
+		}
+		dev->byte_cnt += 2 * w;
+	}
+	return (0);
+}
+
+/**
+ * cmd
+ */
+static int cmd(disp dev, uint8_t c, const uint8_t *par, int n)
+{
+	int ret;
+
+	if (dev->bus == DISP_BUS_SPI) {
+		set_pin_lev(dev->dc_pin, dev->dc_port, FALSE);
+		if ((ret = spi_transfer(dev->bdev->bus->spi, &c, NULL, 1)) || !n) {
+			return (ret);
+		}
+		if (dev->ctrl == DISP_CTRL_ST7735) {
+			set_pin_lev(dev->dc_pin, dev->dc_port, TRUE);
+		}
+		return (spi_transfer(dev->bdev->bus->spi, par, NULL, n));
+	}
+#if I2C_MASTER == 1
+	struct i2c_msg msg;
+
+	dev->i2c_buf[0] = 0x00;
+	dev->i2c_buf[1] = c;
+	memcpy(dev->i2c_buf + 2, par, n);
+	msg.addr = dev->i2c_addr;
+	msg.wr_buf = dev->i2c_buf;
+	msg.wr_size = n + 2;
+	msg.rd_size = 0;
+	return (i2c_transfer(dev->i2c, &msg, 1, 100 / portTICK_PERIOD_MS));
+#else
+	return (-EGEN);
+#endif
+}
+
+/**
+ * data
+ */
+static int data(disp dev, const uint8_t *p, int n)
+{
+	if (dev->bus == DISP_BUS_SPI) {
+		set_pin_lev(dev->dc_pin, dev->dc_port, TRUE);
+		return (spi_transfer(dev->bdev->bus->spi, p, NULL, n));
+	}
+#if I2C_MASTER == 1
+	struct i2c_msg msg;
+	int sz, ret;
+
+	dev->i2c_buf[0] = 0x40;
+	msg.addr = dev->i2c_addr;
+	msg.wr_buf = dev->i2c_buf;
+	msg.rd_size = 0;
+	while (n) {
+		sz = (n > (int) sizeof(dev->i2c_buf) - 1) ? (int) sizeof(dev->i2c_buf) - 1 : n;
+		memcpy(dev->i2c_buf + 1, p, sz);
+		msg.wr_size = sz + 1;
+		if ((ret = i2c_transfer(dev->i2c, &msg, 1, 100 / portTICK_PERIOD_MS))) {
+			return (ret);
+		}
+		p += sz;
+		n -= sz;
+	}
+	return (0);
+#else
+	return (-EGEN);
+#endif
+}
+
+/**
+ * begin
+ */
+static void begin(disp dev)
+{
+	if (dev->bus == DISP_BUS_SPI) {
+		spibus_acquire(dev->bdev);
+		spibus_cs(dev->bdev, TRUE);
+	}
+}
+
+/**
+ * end
+ */
+static void end(disp dev)
+{
+	if (dev->bus == DISP_BUS_SPI) {
+		spibus_cs(dev->bdev, FALSE);
+		spibus_release(dev->bdev);
+	}
+}
+
+#if TERMOUT == 1
+/**
+ * log_disp_stats
+ */
+void log_disp_stats(disp dev)
+{
+	msg(INF, "disp.c: <%s> flush=%u rect=%u bytes=%u err=%d\n",
+	    dev->tsk_nm, dev->flush_cnt, dev->rect_cnt, dev->byte_cnt, dev->err);
+}
+#endif
+
+#endif
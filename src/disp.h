@@ -0,0 +1,139 @@
+/*
+ * disp.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DISP_H
+#define DISP_H
+
+#ifndef DISP
+ #define DISP 0
+#endif
+#ifndef DISP_DIRTY_MAX
+ #define DISP_DIRTY_MAX 8
+#endif
+#ifndef DISP_RETRY_TICKS
+ #define DISP_RETRY_TICKS 10
+#endif
+
+#if DISP == 1
+
+#include "spibus.h"
+#include "i2c.h"
+
+enum disp_ctrl {
+	DISP_CTRL_SSD1306,
+	DISP_CTRL_ST7735
+};
+
+enum disp_bus {
+	DISP_BUS_SPI,
+	DISP_BUS_I2C
+};
+
+struct disp_rect {
+	short x0;
+	short y0;
+	short x1;
+	short y1;
+};
+
+typedef struct disp_dsc *disp;
+
+struct disp_dsc {
+	enum disp_ctrl ctrl; // <SetIt>
+	enum disp_bus bus; // <SetIt> - DISP_BUS_I2C only for SSD1306.
+	int width; // <SetIt>
+	int height; // <SetIt>
+	uint8_t *fb; // <SetIt> - Framebuffer (SSD1306: width * height / 8 bytes in page layout, ST7735: width * height RGB565 pixels, big endian).
+	spibus_dev bdev; // <SetIt> [DISP_BUS_SPI]
+	int dc_pin; // <SetIt> [DISP_BUS_SPI]
+	PortGroup *dc_port; // <SetIt> [DISP_BUS_SPI]
+	void *i2c; // <SetIt> [DISP_BUS_I2C] - I2C master instance.
+	int i2c_addr; // <SetIt> [DISP_BUS_I2C]
+	int x_ofs; // <SetIt> [DISP_CTRL_ST7735] - Panel column offset.
+	int y_ofs; // <SetIt> [DISP_CTRL_ST7735] - Panel row offset.
+	uint8_t madctl; // <SetIt> [DISP_CTRL_ST7735] - Memory data access control.
+	const char *tsk_nm; // <SetIt>
+	TaskHandle_t tsk_hndl;
+	struct disp_rect dirty[DISP_DIRTY_MAX];
+	int dirty_cnt;
+	uint8_t i2c_buf[129];
+	int err;
+	unsigned int flush_cnt;
+	unsigned int rect_cnt;
+	unsigned int byte_cnt;
+};
+
+/**
+ * init_disp
+ *
+ * Create flush task which initializes display controller first (can be
+ * called before scheduler is started). Framebuffer can be drawn and marked
+ * at once, regions are flushed after controller initialization.
+ *
+ * @dev: Display instance.
+ */
+void init_disp(disp dev);
+
+/**
+ * disp_mark
+ *
+ * Mark framebuffer region as changed. Region is merged with touching or
+ * overlapping dirty rectangles; if list of DISP_DIRTY_MAX rectangles is
+ * full, region is merged with rectangle which grows least.
+ *
+ * @dev: Display instance.
+ * @x: Left column.
+ * @y: Top row.
+ * @w: Width.
+ * @h: Height.
+ */
+void disp_mark(disp dev, int x, int y, int w, int h);
+
+/**
+ * disp_fill_rect
+ *
+ * Fill framebuffer rectangle and mark it dirty.
+ *
+ * @dev: Display instance.
+ * @x: Left column.
+ * @y: Top row.
+ * @w: Width.
+ * @h: Height.
+ * @color: SSD1306 - 0 (off) or 1 (on); ST7735 - RGB565.
+ */
+void disp_fill_rect(disp dev, int x, int y, int w, int h, unsigned int color);
+
+/**
+ * disp_flush
+ *
+ * Request flush of dirty rectangles. Flush runs in display task, caller
+ * is not blocked.
+ *
+ * @dev: Display instance.
+ */
+void disp_flush(disp dev);
+
+#if TERMOUT == 1
+/**
+ * log_disp_stats
+ */
+void log_disp_stats(disp dev);
+#endif
+#endif
+
+#endif
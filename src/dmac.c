@@ -27,6 +27,7 @@
 #include "atom.h"
 #include "msgconf.h"
 #include "criterr.h"
+#include "hwerr.h"
 #include "pm.h"
 #include "dmac.h"
 #include <string.h>
@@ -36,6 +37,15 @@
 __attribute__((aligned(16))) static DmacDescriptor descriptors[DMAC_CHANNELS_NUM];
 __attribute__((aligned(16))) static DmacDescriptor writebacks[DMAC_CHANNELS_NUM];
 static struct dmac_channel_desc channels[DMAC_CHANNELS_NUM];
+#if DMAC_CRC == 1
+static dmac_channel crc_chn;
+static SemaphoreHandle_t crc_mtx;
+static QueueHandle_t crc_que;
+static enum crc_type crc_typ;
+static uint32_t crc_dummy;
+
+static BaseType_t crc_dma_hndlr(void *dev, enum dmac_intr intr);
+#endif
 
 /**
  * init_dmac
@@ -107,7 +117,8 @@ boolean_t is_dmac_enabled(void)
 dmac_channel alloc_dmac_channel(void)
 {
 	taskENTER_CRITICAL();
-	for (int i = 0; i < DMAC_CHANNELS_NUM; i++) {
+	for (int n = 0; n < DMAC_CHANNELS_NUM; n++) {
+		int i = (n + DMAC_EVIN_NUM) % DMAC_CHANNELS_NUM;
 		if (channels[i].used) {
 			continue;
 		} else {
@@ -121,6 +132,46 @@ dmac_channel alloc_dmac_channel(void)
 	return (NULL);
 }
 
+/**
+ * alloc_dmac_ev_channel
+ */
+dmac_channel alloc_dmac_ev_channel(void)
+{
+	taskENTER_CRITICAL();
+	for (int i = 0; i < DMAC_EVIN_NUM && i < DMAC_CHANNELS_NUM; i++) {
+		if (!channels[i].used) {
+			channels[i].used = TRUE;
+			channels[i].trans_desc = &descriptors[i];
+                        taskEXIT_CRITICAL();
+			return (&channels[i]);
+		}
+	}
+        taskEXIT_CRITICAL();
+	return (NULL);
+}
+
+/**
+ * dmac_ev_user
+ */
+int dmac_ev_user(dmac_channel channel)
+{
+	if (channel->id >= DMAC_EVIN_NUM) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	return (EVSYS_ID_USER_DMAC_CH_0 + channel->id);
+}
+
+/**
+ * dmac_ev_gen
+ */
+int dmac_ev_gen(dmac_channel channel)
+{
+	if (channel->id >= DMAC_EVOUT_NUM) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	return (EVSYS_ID_GEN_DMAC_CH_0 + channel->id);
+}
+
 /**
  * reset_dmac_channel
  */
@@ -143,13 +194,37 @@ void reset_dmac_channel(dmac_channel channel)
 void enable_dmac_transfer(dmac_channel channel)
 {
         taskENTER_CRITICAL();
+	enable_dmac_transfer_isr(channel);
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * enable_dmac_transfer_isr
+ */
+void enable_dmac_transfer_isr(dmac_channel channel)
+{
+	unsigned int ev = 0;
+
+	if (channel->evact != DMAC_EVACT_NOACT) {
+		if (channel->id >= DMAC_EVIN_NUM) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		ev |= DMAC_CHCTRLB_EVACT(channel->evact) | DMAC_CHCTRLB_EVIE;
+	}
+	if (channel->evoe) {
+		if (channel->id >= DMAC_EVOUT_NUM) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		ev |= DMAC_CHCTRLB_EVOE;
+	}
 	DMAC->CHID.reg = channel->id;
         DMAC->CHCTRLB.reg = DMAC_CHCTRLB_TRIGACT(channel->trg_action) |
 	                    DMAC_CHCTRLB_TRIGSRC(channel->trg_source) |
-			    DMAC_CHCTRLB_LVL(channel->prio_level);
+			    DMAC_CHCTRLB_LVL(channel->prio_level) | ev;
+	// Write-back descriptor is stale until channel fetches descriptor.
+	writebacks[channel->id].BTCNT.reg = channel->trans_desc->BTCNT.reg;
 	DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
         DMAC->CHCTRLA.reg = DMAC_CHCTRLA_ENABLE;
-	taskEXIT_CRITICAL();
 }
 
 /**
@@ -175,6 +250,231 @@ void disable_dmac_channel_intr(dmac_channel channel)
 	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR;
 }
 
+/**
+ * dmac_channel_progress
+ */
+int dmac_channel_progress(dmac_channel channel)
+{
+	int n;
+
+	taskENTER_CRITICAL();
+	DMAC->CHID.reg = channel->id;
+	if (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE) {
+		DMAC->CHCTRLB.reg = (DMAC->CHCTRLB.reg & ~DMAC_CHCTRLB_CMD_Msk) | DMAC_CHCTRLB_CMD_SUSPEND;
+		while (!(DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_SUSP) &&
+		       DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+	}
+	n = channel->trans_desc->BTCNT.reg - writebacks[channel->id].BTCNT.reg;
+	taskEXIT_CRITICAL();
+	return (n);
+}
+
+/**
+ * dmac_channel_remain
+ */
+int dmac_channel_remain(dmac_channel channel, boolean_t *cmpl)
+{
+	UBaseType_t m;
+	uint8_t f1, f2;
+	int rem;
+
+	m = taskENTER_CRITICAL_FROM_ISR();
+	DMAC->CHID.reg = channel->id;
+	do {
+		f1 = DMAC->CHINTFLAG.reg;
+		rem = writebacks[channel->id].BTCNT.reg;
+		f2 = DMAC->CHINTFLAG.reg;
+	} while ((f1 ^ f2) & DMAC_CHINTFLAG_TCMPL);
+	taskEXIT_CRITICAL_FROM_ISR(m);
+	*cmpl = (f2 & DMAC_CHINTFLAG_TCMPL) ? TRUE : FALSE;
+	return (rem);
+}
+
+/**
+ * clear_dmac_channel_intr
+ */
+void clear_dmac_channel_intr(dmac_channel channel)
+{
+	DMAC->CHID.reg = channel->id;
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR;
+}
+
+/**
+ * dmac_channel_resume
+ */
+void dmac_channel_resume(dmac_channel channel)
+{
+	taskENTER_CRITICAL();
+	DMAC->CHID.reg = channel->id;
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_SUSP;
+	DMAC->CHCTRLB.reg = (DMAC->CHCTRLB.reg & ~DMAC_CHCTRLB_CMD_Msk) | DMAC_CHCTRLB_CMD_RESUME;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * dmac_channel_abort
+ */
+int dmac_channel_abort(dmac_channel channel)
+{
+	int n;
+
+	taskENTER_CRITICAL();
+	n = dmac_channel_abort_isr(channel);
+	taskEXIT_CRITICAL();
+	return (n);
+}
+
+/**
+ * dmac_channel_abort_isr
+ */
+int dmac_channel_abort_isr(dmac_channel channel)
+{
+	int n;
+
+	DMAC->CHID.reg = channel->id;
+	if (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE) {
+		DMAC->CHCTRLB.reg = (DMAC->CHCTRLB.reg & ~DMAC_CHCTRLB_CMD_Msk) | DMAC_CHCTRLB_CMD_SUSPEND;
+		while (!(DMAC->CHINTFLAG.reg & DMAC_CHINTFLAG_SUSP) &&
+		       DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+	}
+	n = channel->trans_desc->BTCNT.reg - writebacks[channel->id].BTCNT.reg;
+	disable_dmac_channel_intr(channel);
+	DMAC->CHID.reg = channel->id;
+	DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+	while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_ENABLE);
+	DMAC->CHINTFLAG.reg = DMAC_CHINTFLAG_SUSP;
+	return (n);
+}
+
+/**
+ * dmac_sw_trigger
+ */
+void dmac_sw_trigger(dmac_channel channel)
+{
+	taskENTER_CRITICAL();
+	DMAC->SWTRIGCTRL.reg |= 1 << channel->id;
+	taskEXIT_CRITICAL();
+}
+
+#if DMAC_CRC == 1
+/**
+ * init_dmac_crc
+ */
+void init_dmac_crc(void)
+{
+	if (crc_chn != NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (NULL == (crc_mtx = xSemaphoreCreateMutex())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	if (NULL == (crc_que = xQueueCreate(1, sizeof(uint8_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	if (NULL == (crc_chn = alloc_dmac_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	crc_chn->dev = NULL;
+	crc_chn->hndlr = crc_dma_hndlr;
+	crc_chn->trg_action = DMAC_TRG_ACTION_BLOCK;
+	crc_chn->trg_source = DMAC_CHCTRLB_TRIGSRC_DISABLE_Val;
+	crc_chn->prio_level = DMAC_CHAN_PRIO_LEVEL0;
+}
+
+/**
+ * crc_compute
+ */
+int crc_compute(const void *p_buf, int size, enum crc_type type, unsigned int *crc)
+{
+	DmacDescriptor *desc;
+	enum crc_beat_size bs;
+	int n;
+	uint8_t er;
+
+	if (crc_chn == NULL) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (!(((unsigned int) p_buf | size) & 0x03)) {
+		bs = CRC_BEAT_SIZE_WORD;
+	} else if (!(((unsigned int) p_buf | size) & 0x01)) {
+		bs = CRC_BEAT_SIZE_HWORD;
+	} else {
+		bs = CRC_BEAT_SIZE_BYTE;
+	}
+	crc_chan_start(crc_chn, type, bs);
+	desc = crc_chn->trans_desc;
+	while (size > 0) {
+		n = size >> bs;
+		if (n > 0xFFFF) {
+			n = 0xFFFF;
+		}
+		desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE(bs) | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_VALID;
+		desc->BTCNT.reg = n;
+		desc->SRCADDR.reg = (unsigned int) p_buf + (n << bs);
+		desc->DSTADDR.reg = (unsigned int) &crc_dummy;
+		desc->DESCADDR.reg = 0;
+		enable_dmac_transfer(crc_chn);
+		dmac_sw_trigger(crc_chn);
+		xQueueReceive(crc_que, &er, portMAX_DELAY);
+		if (er) {
+			reset_dmac_channel(crc_chn);
+			crc_chan_stop();
+			return (-EDMA);
+		}
+		p_buf = (const uint8_t *) p_buf + (n << bs);
+		size -= n << bs;
+	}
+	*crc = crc_chan_stop();
+	return (0);
+}
+
+/**
+ * crc_chan_start
+ */
+void crc_chan_start(dmac_channel channel, enum crc_type type, enum crc_beat_size bs)
+{
+	xSemaphoreTake(crc_mtx, portMAX_DELAY);
+	crc_typ = type;
+	taskENTER_CRITICAL();
+	DMAC->CTRL.reg &= ~DMAC_CTRL_CRCENABLE;
+	DMAC->CRCCTRL.reg = DMAC_CRCCTRL_CRCBEATSIZE(bs) | DMAC_CRCCTRL_CRCPOLY(type) |
+	                    DMAC_CRCCTRL_CRCSRC(0x20 + channel->id);
+	DMAC->CRCCHKSUM.reg = (type == CRC32) ? 0xFFFFFFFF : 0;
+	DMAC->CTRL.reg |= DMAC_CTRL_CRCENABLE;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * crc_chan_stop
+ */
+unsigned int crc_chan_stop(void)
+{
+	unsigned int crc;
+
+	while (DMAC->CRCSTATUS.reg & DMAC_CRCSTATUS_CRCBUSY);
+	crc = DMAC->CRCCHKSUM.reg;
+	taskENTER_CRITICAL();
+	DMAC->CTRL.reg &= ~DMAC_CTRL_CRCENABLE;
+	DMAC->CRCCTRL.reg = 0;
+	taskEXIT_CRITICAL();
+	xSemaphoreGive(crc_mtx);
+	return ((crc_typ == CRC16) ? crc & 0xFFFF : crc);
+}
+
+/**
+ * crc_dma_hndlr
+ */
+static BaseType_t crc_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	uint8_t er = (intr == DMAC_TCMPL_INTR) ? 0 : 1;
+
+	disable_dmac_channel_intr(crc_chn);
+	xQueueSendFromISR(crc_que, &er, &tsk_wkn);
+	return (tsk_wkn);
+}
+#endif
+
 /**
  * DMAC_Handler
  */
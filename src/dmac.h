@@ -19,6 +19,10 @@
 #ifndef DMAC_H
 #define DMAC_H
 
+#ifndef DMAC_CRC
+ #define DMAC_CRC 0
+#endif
+
 #if DMAC_ON_CHIP == 1
 
 enum dmac_intr {
@@ -40,12 +44,24 @@ enum dmac_chan_prio_level {
         DMAC_CHAN_PRIO_LEVEL3
 };
 
+enum dmac_evact {
+	DMAC_EVACT_NOACT,
+	DMAC_EVACT_TRIG,
+        DMAC_EVACT_CTRIG,
+        DMAC_EVACT_CBLOCK,
+        DMAC_EVACT_SUSPEND,
+        DMAC_EVACT_RESUME,
+        DMAC_EVACT_SSKIP
+};
+
 struct dmac_channel_desc {
 	void *dev; // <SetIt>
 	BaseType_t (*hndlr)(void *dev, enum dmac_intr intr); // <SetIt>
         enum dmac_trg_action trg_action; // <SetIt>
 	int trg_source; // <SetIt>
 	enum dmac_chan_prio_level prio_level; // <SetIt>
+	enum dmac_evact evact; // <SetIt> - Event input action (event channels only).
+	boolean_t evoe; // <SetIt> - Event output enable (event channels only).
         DmacDescriptor *trans_desc; // <SetIt>
 	boolean_t used;
 	int id;
@@ -75,9 +91,39 @@ boolean_t is_dmac_enabled(void);
 
 /**
  * alloc_dmac_channel
+ *
+ * Allocate DMAC channel. Channels without event input/output are preferred.
+ *
+ * Returns: DMAC channel; NULL - no free channel.
  */
 dmac_channel alloc_dmac_channel(void);
 
+/**
+ * alloc_dmac_ev_channel
+ *
+ * Allocate DMAC channel with event input and event output
+ * (channels 0 - DMAC_EVIN_NUM-1).
+ *
+ * Returns: DMAC channel; NULL - no free event channel.
+ */
+dmac_channel alloc_dmac_ev_channel(void);
+
+/**
+ * dmac_ev_user
+ *
+ * Returns: EVSYS user number of DMAC channel event input.
+ */
+int dmac_ev_user(dmac_channel channel);
+
+/**
+ * dmac_ev_gen
+ *
+ * Returns: EVSYS generator number of DMAC channel event output.
+ * Event is generated when block/beat transfer of descriptor with
+ * BTCTRL.EVOSEL set is completed and channel->evoe is TRUE.
+ */
+int dmac_ev_gen(dmac_channel channel);
+
 /**
  * reset_dmac_channel
  */
@@ -85,9 +131,25 @@ void reset_dmac_channel(dmac_channel channel);
 
 /**
  * enable_dmac_transfer
+ *
+ * Configure channel trigger, priority and events and enable channel.
+ * Event action DMAC_EVACT_TRIG requires trg_source 0 (software/event
+ * trigger only).
+ *
+ * @channel: DMAC channel.
  */
 void enable_dmac_transfer(dmac_channel channel);
 
+/**
+ * enable_dmac_transfer_isr
+ *
+ * Variant of enable_dmac_transfer() for interrupt handlers running at
+ * library interrupt priority (or caller inside critical section).
+ *
+ * @channel: DMAC channel.
+ */
+void enable_dmac_transfer_isr(dmac_channel channel);
+
 /**
  * disable_dmac_channel
  */
@@ -97,6 +159,145 @@ void disable_dmac_channel(dmac_channel channel);
  * disable_dmac_channel_intr
  */
 void disable_dmac_channel_intr(dmac_channel channel);
+
+/**
+ * dmac_channel_progress
+ *
+ * Suspend channel and get exact number of beats transferred by channel
+ * descriptor (channel->trans_desc, single block transfers). Channel stays
+ * suspended and can be restarted by dmac_channel_resume(). If transfer is
+ * finished or stopped by error, channel is not suspended.
+ * Count is valid for single descriptor (not linked) transfers only.
+ *
+ * @channel: DMAC channel.
+ *
+ * Returns: Number of transferred beats.
+ */
+int dmac_channel_progress(dmac_channel channel);
+
+/**
+ * dmac_channel_remain
+ *
+ * Get number of beats remaining in current block from write-back descriptor
+ * without channel suspend (circular transfers). Value is updated by DMAC
+ * after every beat and is equal to block size before first beat.
+ * Can be called from task and ISR.
+ *
+ * @channel: DMAC channel.
+ * @cmpl: Block complete interrupt is pending (not serviced yet).
+ *
+ * Returns: Number of beats remaining.
+ */
+int dmac_channel_remain(dmac_channel channel, boolean_t *cmpl);
+
+/**
+ * clear_dmac_channel_intr
+ *
+ * Clear channel interrupt flags, interrupts stay enabled (circular transfers).
+ */
+void clear_dmac_channel_intr(dmac_channel channel);
+
+/**
+ * dmac_channel_resume
+ *
+ * Resume channel suspended by dmac_channel_progress().
+ *
+ * @channel: DMAC channel.
+ */
+void dmac_channel_resume(dmac_channel channel);
+
+/**
+ * dmac_channel_abort
+ *
+ * Stop transfer and disable channel.
+ * Count is valid for single descriptor (not linked) transfers only.
+ *
+ * @channel: DMAC channel.
+ *
+ * Returns: Number of beats transferred before abort.
+ */
+int dmac_channel_abort(dmac_channel channel);
+
+/**
+ * dmac_channel_abort_isr
+ *
+ * Variant of dmac_channel_abort() for interrupt handlers running at
+ * library interrupt priority (or caller inside critical section).
+ *
+ * @channel: DMAC channel.
+ *
+ * Returns: Number of beats transferred before abort.
+ */
+int dmac_channel_abort_isr(dmac_channel channel);
+
+/**
+ * dmac_sw_trigger
+ *
+ * Generate software trigger for enabled DMAC channel.
+ *
+ * @channel: DMAC channel.
+ */
+void dmac_sw_trigger(dmac_channel channel);
+
+#if DMAC_CRC == 1
+enum crc_type {
+	CRC16,
+	CRC32
+};
+
+enum crc_beat_size {
+	CRC_BEAT_SIZE_BYTE,
+	CRC_BEAT_SIZE_HWORD,
+	CRC_BEAT_SIZE_WORD
+};
+
+/**
+ * init_dmac_crc
+ *
+ * Allocate DMAC channel for memory buffer CRC calculation and initialize
+ * CRC engine lock.
+ */
+void init_dmac_crc(void);
+
+/**
+ * crc_compute
+ *
+ * Compute CRC of memory buffer by DMAC CRC engine. Data are moved by DMAC
+ * channel (software trigger), caller task is blocked during calculation.
+ * CRC16 - CRC-16/CCITT, polynomial 0x1021, initial value 0x0000 (XMODEM).
+ * CRC32 - CRC-32/IEEE 802.3, initial value 0xFFFFFFFF, complemented result.
+ *
+ * @p_buf: Pointer to data buffer.
+ * @size: Buffer size in bytes.
+ * @type: CRC type (enum crc_type).
+ * @crc: Pointer to CRC checksum.
+ *
+ * Returns: 0 - success; -EDMA - dma error.
+ */
+int crc_compute(const void *p_buf, int size, enum crc_type type, unsigned int *crc);
+
+/**
+ * crc_chan_start
+ *
+ * Start CRC calculation of data passing through DMAC channel (inline mode).
+ * CRC engine is locked until crc_chan_stop() is called. Beat size must be
+ * equal to beat size of channel transfer descriptors.
+ *
+ * @channel: DMAC channel.
+ * @type: CRC type (enum crc_type).
+ * @bs: Beat size (enum crc_beat_size).
+ */
+void crc_chan_start(dmac_channel channel, enum crc_type type, enum crc_beat_size bs);
+
+/**
+ * crc_chan_stop
+ *
+ * Stop inline CRC calculation and unlock CRC engine.
+ *
+ * Returns: CRC checksum of data transferred since crc_chan_start().
+ */
+unsigned int crc_chan_stop(void);
+#endif
 #endif
 
 #endif
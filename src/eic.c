@@ -166,6 +166,11 @@ void conf_eintctl_pin(eintctl_pin pin)
 	} else {
 		EIC->WAKEUP.reg &= ~(1 << pin->n);
 	}
+	if (pin->evout) {
+		EIC->EVCTRL.reg |= 1 << pin->n;
+	} else {
+		EIC->EVCTRL.reg &= ~(1 << pin->n);
+	}
 	taskEXIT_CRITICAL();
 }
 
@@ -196,6 +201,7 @@ void disable_eintctl_pin(eintctl_pin pin)
 		EIC->CONFIG[0].reg = r;
 	}
 	EIC->WAKEUP.reg &= ~(1 << pin->n);
+	EIC->EVCTRL.reg &= ~(1 << pin->n);
 	taskEXIT_CRITICAL();
 }
 
@@ -40,6 +40,7 @@ struct eintctl_pin_cfg {
 	boolean_t wake;
 	boolean_t filt;
 	enum eintctl_intr_mode intr_mode;
+	boolean_t evout;
 };
 
 enum eintctl_gclk {
@@ -0,0 +1,181 @@
+/*
+ * evsys.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "evsys.h"
+
+#if EVSYSCTL == 1
+
+static struct evsys_channel_desc channels[EVSYS_CHANNELS];
+
+static inline unsigned int usrrdy_msk(int id);
+static inline unsigned int chbusy_msk(int id);
+
+/**
+ * init_evsys
+ */
+void init_evsys(void)
+{
+	for (int i = 0; i < EVSYS_CHANNELS; i++) {
+		channels[i].id = i;
+	}
+	enable_per_apb_clk(APB_BUS_INST_C, PM_APBCMASK_EVSYS);
+	EVSYS->CTRL.reg = EVSYS_CTRL_SWRST;
+	while (EVSYS->CTRL.reg & EVSYS_CTRL_SWRST);
+}
+
+/**
+ * enable_evsys
+ */
+void enable_evsys(void)
+{
+	enable_per_apb_clk(APB_BUS_INST_C, PM_APBCMASK_EVSYS);
+	for (int i = 0; i < EVSYS_CHANNELS; i++) {
+		if (channels[i].used && channels[i].path != EVSYS_PATH_ASYNCHRONOUS) {
+			re_enable_clk_channel(GCLK_CLKCTRL_ID_EVSYS_0_Val + i);
+		}
+	}
+}
+
+/**
+ * disable_evsys
+ */
+void disable_evsys(void)
+{
+	for (int i = 0; i < EVSYS_CHANNELS; i++) {
+		if (channels[i].used && channels[i].path != EVSYS_PATH_ASYNCHRONOUS) {
+			disable_clk_channel(GCLK_CLKCTRL_ID_EVSYS_0_Val + i);
+		}
+	}
+	disable_per_apb_clk(APB_BUS_INST_C, PM_APBCMASK_EVSYS);
+}
+
+/**
+ * alloc_evsys_channel
+ */
+evsys_channel alloc_evsys_channel(void)
+{
+	taskENTER_CRITICAL();
+	for (int i = 0; i < EVSYS_CHANNELS; i++) {
+		if (!channels[i].used) {
+			channels[i].used = TRUE;
+			taskEXIT_CRITICAL();
+			return (&channels[i]);
+		}
+	}
+	taskEXIT_CRITICAL();
+	return (NULL);
+}
+
+/**
+ * free_evsys_channel
+ */
+void free_evsys_channel(evsys_channel ch)
+{
+	taskENTER_CRITICAL();
+	EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(ch->id);
+	taskEXIT_CRITICAL();
+	if (ch->path != EVSYS_PATH_ASYNCHRONOUS) {
+		disable_clk_channel(GCLK_CLKCTRL_ID_EVSYS_0_Val + ch->id);
+	}
+	ch->used = FALSE;
+}
+
+/**
+ * conf_evsys_channel
+ */
+void conf_evsys_channel(evsys_channel ch)
+{
+	unsigned int r;
+
+	r = EVSYS_CHANNEL_CHANNEL(ch->id) | EVSYS_CHANNEL_EVGEN(ch->gen) | EVSYS_CHANNEL_PATH(ch->path);
+	if (ch->path != EVSYS_PATH_ASYNCHRONOUS) {
+		enable_clk_channel(GCLK_CLKCTRL_ID_EVSYS_0_Val + ch->id, ch->clk_gen);
+		r |= EVSYS_CHANNEL_EDGSEL(ch->edge);
+	}
+	taskENTER_CRITICAL();
+	EVSYS->CHANNEL.reg = r;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * evsys_connect_user
+ */
+void evsys_connect_user(evsys_channel ch, int user)
+{
+	taskENTER_CRITICAL();
+	EVSYS->USER.reg = EVSYS_USER_USER(user) | EVSYS_USER_CHANNEL(ch->id + 1);
+	taskEXIT_CRITICAL();
+	if (ch->path != EVSYS_PATH_ASYNCHRONOUS) {
+		while (!(EVSYS->CHSTATUS.reg & usrrdy_msk(ch->id)));
+	}
+}
+
+/**
+ * evsys_disconnect_user
+ */
+void evsys_disconnect_user(int user)
+{
+	taskENTER_CRITICAL();
+	EVSYS->USER.reg = EVSYS_USER_USER(user) | EVSYS_USER_CHANNEL_0;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * evsys_sw_event
+ */
+void evsys_sw_event(evsys_channel ch)
+{
+	if (ch->path != EVSYS_PATH_ASYNCHRONOUS) {
+		while (EVSYS->CHSTATUS.reg & chbusy_msk(ch->id));
+	}
+	taskENTER_CRITICAL();
+	EVSYS->CHANNEL.reg = EVSYS_CHANNEL_CHANNEL(ch->id) | EVSYS_CHANNEL_EVGEN(ch->gen) |
+	                     EVSYS_CHANNEL_PATH(ch->path) | EVSYS_CHANNEL_EDGSEL(ch->edge) |
+	                     EVSYS_CHANNEL_SWEVT;
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * usrrdy_msk
+ */
+static inline unsigned int usrrdy_msk(int id)
+{
+	return ((id < 8) ? 1U << id : 1U << (16 + id - 8));
+}
+
+/**
+ * chbusy_msk
+ */
+static inline unsigned int chbusy_msk(int id)
+{
+	return ((id < 8) ? 1U << (8 + id) : 1U << (24 + id - 8));
+}
+#endif
@@ -0,0 +1,128 @@
+/*
+ * evsys.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef EVSYS_H
+#define EVSYS_H
+
+#ifndef EVSYSCTL
+ #define EVSYSCTL 0
+#endif
+
+#if EVSYSCTL == 1
+
+enum evsys_path {
+	EVSYS_PATH_SYNCHRONOUS,
+	EVSYS_PATH_RESYNCHRONIZED,
+        EVSYS_PATH_ASYNCHRONOUS
+};
+
+enum evsys_edge {
+	EVSYS_EDGE_NO_EVT_OUTPUT,
+	EVSYS_EDGE_RISING,
+        EVSYS_EDGE_FALLING,
+        EVSYS_EDGE_BOTH
+};
+
+struct evsys_channel_desc {
+	int gen; // <SetIt> - Event generator (EVSYS_ID_GEN_xxx).
+	enum evsys_path path; // <SetIt>
+	enum evsys_edge edge; // <SetIt> - Not used for asynchronous path.
+	int clk_gen; // <SetIt> - GCLK instance. Not used for asynchronous path.
+	boolean_t used;
+	int id;
+};
+
+typedef struct evsys_channel_desc *evsys_channel;
+
+/**
+ * init_evsys
+ *
+ * Initialize EVSYS controller.
+ */
+void init_evsys(void);
+
+/**
+ * enable_evsys
+ *
+ * Enable EVSYS controller (revert disable_evsys() function effects).
+ */
+void enable_evsys(void);
+
+/**
+ * disable_evsys
+ *
+ * Disable EVSYS controller (switch APB and channels clocks off).
+ */
+void disable_evsys(void);
+
+/**
+ * alloc_evsys_channel
+ *
+ * Returns: EVSYS channel; NULL - no free channel.
+ */
+evsys_channel alloc_evsys_channel(void);
+
+/**
+ * free_evsys_channel
+ *
+ * Disconnect channel from generator and return it to free pool.
+ * Users connected to channel must be disconnected by caller.
+ *
+ * @ch: EVSYS channel.
+ */
+void free_evsys_channel(evsys_channel ch);
+
+/**
+ * conf_evsys_channel
+ *
+ * Connect EVSYS channel to event generator.
+ *
+ * @ch: EVSYS channel.
+ */
+void conf_evsys_channel(evsys_channel ch);
+
+/**
+ * evsys_connect_user
+ *
+ * Connect event user to EVSYS channel.
+ *
+ * @ch: EVSYS channel.
+ * @user: Event user (EVSYS_ID_USER_xxx).
+ */
+void evsys_connect_user(evsys_channel ch, int user);
+
+/**
+ * evsys_disconnect_user
+ *
+ * Disconnect event user from EVSYS channel.
+ *
+ * @user: Event user (EVSYS_ID_USER_xxx).
+ */
+void evsys_disconnect_user(int user);
+
+/**
+ * evsys_sw_event
+ *
+ * Generate software event on EVSYS channel.
+ *
+ * @ch: EVSYS channel.
+ */
+void evsys_sw_event(evsys_channel ch);
+#endif
+
+#endif
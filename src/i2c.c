@@ -0,0 +1,694 @@
+/*
+ * i2c.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "sercom.h"
+#include "dmac.h"
+#include "i2c.h"
+
+#define I2C_INTR_ALL (SERCOM_I2CM_INTENCLR_MB | SERCOM_I2CM_INTENCLR_SB | SERCOM_I2CM_INTENCLR_ERROR)
+#define I2C_CMD_STOP 3
+#define I2C_BUSSTATE_IDLE 1
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+static BaseType_t i2c_hndlr(void *dev);
+#endif
+#if I2C_MASTER == 1
+static void start_msg(i2c dev);
+static void start_rd(i2c dev);
+static BaseType_t msg_done(i2c dev, int err);
+static void stop(i2c dev);
+static unsigned int baud_reg(i2c dev);
+#endif
+#if DMAC_ON_CHIP == 1 && I2C_MASTER == 1
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr);
+#endif
+#if I2C_SLAVE == 1
+static BaseType_t slv_hndlr(i2c dev);
+static BaseType_t slv_wr_end(i2c dev);
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * init_i2c
+ */
+void init_i2c(i2c dev, enum i2c_mode m)
+{
+	if (dev->mtx == NULL) {
+		if (NULL == (dev->mtx = xSemaphoreCreateMutex())) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+		if (NULL == (dev->sig_que = xQueueCreate(1, sizeof(uint8_t)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->mode = m;
+        if (dev->standby == I2C_STANDBY_ACTIVE) {
+		dev->reg_ctrla |= SERCOM_I2CM_CTRLA_RUNSTDBY;
+	}
+	switch (m) {
+#if I2C_MASTER == 1
+	case I2C_MASTER_MODE :
+		if (dev->baudrate > 400000) {
+			dev->reg_ctrla |= SERCOM_I2CM_CTRLA_SPEED(1) | SERCOM_I2CM_CTRLA_SDAHOLD(1);
+		} else {
+			dev->reg_ctrla |= SERCOM_I2CM_CTRLA_SDAHOLD(2);
+		}
+		dev->reg_ctrla |= SERCOM_I2CM_CTRLA_MODE_I2C_MASTER;
+		dev->reg_ctrlb |= SERCOM_I2CM_CTRLB_SMEN;
+		dev->reg_baud = baud_reg(dev);
+		break;
+#endif
+#if I2C_SLAVE == 1
+	case I2C_SLAVE_MODE  :
+		if (dev->slv_regs_size < 1 || dev->slv_regs_size > 256) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		if (dev->baudrate > 400000) {
+			dev->reg_ctrla |= SERCOM_I2CS_CTRLA_SPEED(1) | SERCOM_I2CS_CTRLA_SDAHOLD(1);
+		} else {
+			dev->reg_ctrla |= SERCOM_I2CS_CTRLA_SDAHOLD(2);
+		}
+		dev->reg_ctrla |= SERCOM_I2CS_CTRLA_MODE_I2C_SLAVE;
+		dev->reg_ctrlb |= SERCOM_I2CS_CTRLB_SMEN | SERCOM_I2CS_CTRLB_AMODE(dev->addr_mode);
+		dev->reg_addr = SERCOM_I2CS_ADDR_ADDR(dev->addr) | SERCOM_I2CS_ADDR_ADDRMASK(dev->addr_mask);
+		dev->dma = FALSE;
+		break;
+#endif
+	default              :
+		crit_err_exit(BAD_PARAMETER);
+		break;
+	}
+	switch (dev->id) {
+#ifdef SERCOM0
+	case ID_SERCOM0 :
+		dev->mmio = (SercomI2cm *) SERCOM0;
+		dev->irqn = SERCOM0_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+		dev->apb_mask = PM_APBCMASK_SERCOM0;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM0_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x01;
+                dev->dmac_tx_trg_num = 0x02;
+#endif
+		break;
+#endif
+#ifdef SERCOM1
+	case ID_SERCOM1 :
+		dev->mmio = (SercomI2cm *) SERCOM1;
+		dev->irqn = SERCOM1_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM1;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM1_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x03;
+                dev->dmac_tx_trg_num = 0x04;
+#endif
+		break;
+#endif
+#ifdef SERCOM2
+	case ID_SERCOM2 :
+		dev->mmio = (SercomI2cm *) SERCOM2;
+		dev->irqn = SERCOM2_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM2;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM2_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x05;
+                dev->dmac_tx_trg_num = 0x06;
+#endif
+		break;
+#endif
+#ifdef SERCOM3
+        case ID_SERCOM3 :
+		dev->mmio = (SercomI2cm *) SERCOM3;
+		dev->irqn = SERCOM3_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM3;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM3_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x07;
+                dev->dmac_tx_trg_num = 0x08;
+#endif
+		break;
+#endif
+#ifdef SERCOM4
+	case ID_SERCOM4 :
+		dev->mmio = (SercomI2cm *) SERCOM4;
+		dev->irqn = SERCOM4_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM4;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM4_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x09;
+                dev->dmac_tx_trg_num = 0x0A;
+#endif
+		break;
+#endif
+#ifdef SERCOM5
+        case ID_SERCOM5 :
+		dev->mmio = (SercomI2cm *) SERCOM5;
+		dev->irqn = SERCOM5_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM5;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM5_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x0B;
+                dev->dmac_tx_trg_num = 0x0C;
+#endif
+		break;
+#endif
+	default         :
+		crit_err_exit(BAD_PARAMETER);
+		break;
+	}
+#if I2C_SLAVE == 1
+	dev->slv_mmio = (SercomI2cs *) dev->mmio;
+#endif
+#if DMAC_ON_CHIP == 1 && I2C_MASTER == 1
+	if (dev->dma) {
+		if (NULL == (dev->channel = alloc_dmac_channel())) {
+			crit_err_exit(UNEXP_PROG_STATE);
+		}
+		dev->channel->dev = dev;
+		dev->channel->hndlr = dma_hndlr;
+		dev->channel->trg_action = DMAC_TRG_ACTION_BEAT;
+                dev->channel->trg_source = dev->dmac_tx_trg_num;
+                dev->channel->prio_level = DMAC_CHAN_PRIO_LEVEL0;
+	}
+#endif
+	NVIC_DisableIRQ(dev->irqn);
+        enable_clk_channel(dev->clk_chn, dev->clk_gen);
+        enable_per_apb_clk(dev->apb_bus_ins, dev->apb_mask);
+	reg_sercom_pers(dev->id, i2c_hndlr, enable_i2c, disable_i2c, dev);
+        NVIC_SetPriority(dev->irqn, configLIBRARY_API_CALL_INTERRUPT_PRIORITY);
+	enable_i2c(dev);
+}
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * enable_i2c
+ */
+void enable_i2c(void *dev)
+{
+        enable_clk_channel(((i2c) dev)->clk_chn, ((i2c) dev)->clk_gen);
+        enable_per_apb_clk(((i2c) dev)->apb_bus_ins, ((i2c) dev)->apb_mask);
+	((i2c) dev)->mmio->CTRLA.reg = SERCOM_I2CM_CTRLA_SWRST;
+	while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SWRST);
+        NVIC_ClearPendingIRQ(((i2c) dev)->irqn);
+	NVIC_EnableIRQ(((i2c) dev)->irqn);
+#if I2C_SLAVE == 1
+	if (((i2c) dev)->mode == I2C_SLAVE_MODE) {
+		((i2c) dev)->slv_mmio->ADDR.reg = ((i2c) dev)->reg_addr;
+		((i2c) dev)->slv_mmio->CTRLB.reg = ((i2c) dev)->reg_ctrlb;
+		((i2c) dev)->slv_mmio->CTRLA.reg = ((i2c) dev)->reg_ctrla;
+		((i2c) dev)->slv_mmio->CTRLA.reg |= SERCOM_I2CS_CTRLA_ENABLE;
+		while (((i2c) dev)->slv_mmio->SYNCBUSY.reg & SERCOM_I2CS_SYNCBUSY_ENABLE);
+		((i2c) dev)->slv_ptr = 0;
+		((i2c) dev)->slv_ptr_set = FALSE;
+		((i2c) dev)->slv_wr_mask = 0;
+		((i2c) dev)->slv_mmio->INTENSET.reg = SERCOM_I2CS_INTENSET_PREC | SERCOM_I2CS_INTENSET_AMATCH |
+		                                      SERCOM_I2CS_INTENSET_DRDY | SERCOM_I2CS_INTENSET_ERROR;
+		((i2c) dev)->conf_pins(I2C_CONF_PINS);
+		return;
+	}
+#endif
+	((i2c) dev)->mmio->BAUD.reg = ((i2c) dev)->reg_baud;
+	((i2c) dev)->mmio->CTRLB.reg = ((i2c) dev)->reg_ctrlb;
+        while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+	((i2c) dev)->mmio->CTRLA.reg = ((i2c) dev)->reg_ctrla;
+        ((i2c) dev)->mmio->CTRLA.reg |= SERCOM_I2CM_CTRLA_ENABLE;
+	while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_ENABLE);
+	((i2c) dev)->mmio->STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(I2C_BUSSTATE_IDLE);
+        while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+	((i2c) dev)->conf_pins(I2C_CONF_PINS);
+}
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * disable_i2c
+ */
+void disable_i2c(void *dev)
+{
+	NVIC_DisableIRQ(((i2c) dev)->irqn);
+	((i2c) dev)->mmio->CTRLA.reg &= ~SERCOM_I2CM_CTRLA_ENABLE;
+        while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_ENABLE ||
+	       ((i2c) dev)->mmio->CTRLA.reg & SERCOM_I2CM_CTRLA_ENABLE);
+	((i2c) dev)->conf_pins(I2C_PINS_TO_PORT);
+	disable_clk_channel(((i2c) dev)->clk_chn);
+	disable_per_apb_clk(((i2c) dev)->apb_bus_ins, ((i2c) dev)->apb_mask);
+#if DMAC_ON_CHIP == 1 && I2C_MASTER == 1
+	if (((i2c) dev)->dma) {
+		disable_dmac_channel(((i2c) dev)->channel);
+	}
+#endif
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * i2c_submit
+ */
+void i2c_submit(void *dev, struct i2c_msg *msg, int n)
+{
+	uint8_t sig = 0;
+
+	xSemaphoreTake(((i2c) dev)->mtx, portMAX_DELAY);
+	((i2c) dev)->err = 0;
+	xQueueReset(((i2c) dev)->sig_que);
+	if (n < 1) {
+		((i2c) dev)->msg_cnt = 0;
+		xQueueSend(((i2c) dev)->sig_que, &sig, 0);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		if (msg[i].wr_size < 1 && msg[i].rd_size < 1) {
+			// Empty transaction, batch is rejected.
+			for (int j = 0; j < n; j++) {
+				msg[j].err = -EADDR;
+			}
+			((i2c) dev)->err = -EADDR;
+			((i2c) dev)->msg_cnt = 0;
+			xQueueSend(((i2c) dev)->sig_que, &sig, 0);
+			return;
+		}
+	}
+	taskENTER_CRITICAL();
+	((i2c) dev)->msg = msg;
+	((i2c) dev)->msg_cnt = n;
+	start_msg(dev);
+	taskEXIT_CRITICAL();
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * i2c_wait
+ */
+int i2c_wait(void *dev, TickType_t tmo)
+{
+	uint8_t sig;
+	int ret;
+
+	if (pdFALSE == xQueueReceive(((i2c) dev)->sig_que, &sig, tmo)) {
+		taskENTER_CRITICAL();
+		if (((i2c) dev)->msg_cnt) {
+			((i2c) dev)->mmio->INTENCLR.reg = I2C_INTR_ALL;
+#if DMAC_ON_CHIP == 1
+			if (((i2c) dev)->dma_phase) {
+				dmac_channel_abort_isr(((i2c) dev)->channel);
+			}
+#endif
+			stop(dev);
+			((i2c) dev)->mmio->STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(I2C_BUSSTATE_IDLE);
+			while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+			if (((i2c) dev)->err == 0) {
+				((i2c) dev)->err = -ETMO;
+			}
+			do {
+				((i2c) dev)->msg->err = -ETMO;
+				((i2c) dev)->msg++;
+			} while (--((i2c) dev)->msg_cnt);
+		}
+		taskEXIT_CRITICAL();
+		xQueueReset(((i2c) dev)->sig_que);
+	}
+	ret = ((i2c) dev)->err;
+	xSemaphoreGive(((i2c) dev)->mtx);
+	return (ret);
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * i2c_transfer
+ */
+int i2c_transfer(void *dev, struct i2c_msg *msg, int n, TickType_t tmo)
+{
+	i2c_submit(dev, msg, n);
+	return (i2c_wait(dev, tmo));
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * start_msg
+ */
+static void start_msg(i2c dev)
+{
+	dev->pos = 0;
+	dev->rd_phase = FALSE;
+	dev->dma_phase = FALSE;
+	dev->mmio->INTENCLR.reg = I2C_INTR_ALL;
+	if (dev->msg->wr_size < 1) {
+		start_rd(dev);
+		return;
+	}
+#if DMAC_ON_CHIP == 1
+	if (dev->dma && dev->msg->rd_size < 1 && dev->msg->wr_size > 2 && dev->msg->wr_size < 256) {
+		DmacDescriptor *desc = dev->channel->trans_desc;
+		desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_VALID;
+		desc->BTCNT.reg = dev->msg->wr_size;
+		desc->SRCADDR.reg = (unsigned int) (dev->msg->wr_buf + dev->msg->wr_size);
+		desc->DSTADDR.reg = (unsigned int) &dev->mmio->DATA.reg;
+		desc->DESCADDR.reg = 0;
+		dev->channel->trg_source = dev->dmac_tx_trg_num;
+		enable_dmac_transfer_isr(dev->channel);
+		dev->dma_phase = TRUE;
+		dev->mmio->ADDR.reg = SERCOM_I2CM_ADDR_ADDR(dev->msg->addr << 1) | SERCOM_I2CM_ADDR_LENEN |
+		                      SERCOM_I2CM_ADDR_LEN(dev->msg->wr_size);
+		while (dev->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+		dev->mmio->INTENSET.reg = SERCOM_I2CM_INTENSET_ERROR;
+		return;
+	}
+#endif
+	dev->mmio->ADDR.reg = SERCOM_I2CM_ADDR_ADDR(dev->msg->addr << 1);
+	while (dev->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+	dev->mmio->INTENSET.reg = SERCOM_I2CM_INTENSET_MB | SERCOM_I2CM_INTENSET_ERROR;
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * start_rd
+ */
+static void start_rd(i2c dev)
+{
+	dev->pos = 0;
+	dev->rd_phase = TRUE;
+	dev->mmio->INTENCLR.reg = I2C_INTR_ALL;
+	dev->mmio->CTRLB.reg &= ~SERCOM_I2CM_CTRLB_ACKACT;
+	while (dev->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+#if DMAC_ON_CHIP == 1
+	if (dev->dma && dev->msg->rd_size > 2 && dev->msg->rd_size < 256) {
+		DmacDescriptor *desc = dev->channel->trans_desc;
+		desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_VALID;
+		desc->BTCNT.reg = dev->msg->rd_size;
+		desc->SRCADDR.reg = (unsigned int) &dev->mmio->DATA.reg;
+		desc->DSTADDR.reg = (unsigned int) (dev->msg->rd_buf + dev->msg->rd_size);
+		desc->DESCADDR.reg = 0;
+		dev->channel->trg_source = dev->dmac_rx_trg_num;
+		enable_dmac_transfer_isr(dev->channel);
+		dev->dma_phase = TRUE;
+		dev->mmio->ADDR.reg = SERCOM_I2CM_ADDR_ADDR((dev->msg->addr << 1) | 1) | SERCOM_I2CM_ADDR_LENEN |
+		                      SERCOM_I2CM_ADDR_LEN(dev->msg->rd_size);
+		while (dev->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+		dev->mmio->INTENSET.reg = SERCOM_I2CM_INTENSET_MB | SERCOM_I2CM_INTENSET_ERROR;
+		return;
+	}
+#endif
+	dev->dma_phase = FALSE;
+	dev->mmio->ADDR.reg = SERCOM_I2CM_ADDR_ADDR((dev->msg->addr << 1) | 1);
+	while (dev->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+	dev->mmio->INTENSET.reg = I2C_INTR_ALL;
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * msg_done
+ */
+static BaseType_t msg_done(i2c dev, int err)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+
+	dev->mmio->INTENCLR.reg = I2C_INTR_ALL;
+	dev->msg->err = err;
+	if (err && dev->err == 0) {
+		dev->err = err;
+	}
+	dev->msg++;
+	if (--dev->msg_cnt) {
+		start_msg(dev);
+	} else {
+		uint8_t sig = 0;
+		xQueueSendFromISR(dev->sig_que, &sig, &tsk_wkn);
+	}
+	return (tsk_wkn);
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * stop
+ */
+static void stop(i2c dev)
+{
+	dev->mmio->CTRLB.reg |= SERCOM_I2CM_CTRLB_ACKACT | SERCOM_I2CM_CTRLB_CMD(I2C_CMD_STOP);
+	while (dev->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+}
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * i2c_hndlr
+ */
+static BaseType_t i2c_hndlr(void *dev)
+{
+#if I2C_SLAVE == 1
+	if (((i2c) dev)->mode == I2C_SLAVE_MODE) {
+		return (slv_hndlr(dev));
+	}
+#endif
+#if I2C_MASTER == 1
+	uint8_t flg = ((i2c) dev)->mmio->INTFLAG.reg & ((i2c) dev)->mmio->INTENSET.reg;
+	uint16_t st = ((i2c) dev)->mmio->STATUS.reg;
+
+	if (flg & SERCOM_I2CM_INTFLAG_ERROR ||
+	    st & (SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST)) {
+		((i2c) dev)->mmio->INTFLAG.reg = SERCOM_I2CM_INTFLAG_ERROR;
+		((i2c) dev)->mmio->STATUS.reg = SERCOM_I2CM_STATUS_BUSERR | SERCOM_I2CM_STATUS_ARBLOST;
+#if DMAC_ON_CHIP == 1
+		if (((i2c) dev)->dma_phase) {
+			dmac_channel_abort_isr(((i2c) dev)->channel);
+		}
+#endif
+		((i2c) dev)->mmio->STATUS.reg = SERCOM_I2CM_STATUS_BUSSTATE(I2C_BUSSTATE_IDLE);
+		while (((i2c) dev)->mmio->SYNCBUSY.reg & SERCOM_I2CM_SYNCBUSY_SYSOP);
+		return (msg_done(dev, -EHW));
+	}
+	if (flg & SERCOM_I2CM_INTFLAG_SB) {
+		if (((i2c) dev)->pos == ((i2c) dev)->msg->rd_size - 1) {
+			stop(dev);
+			((i2c) dev)->msg->rd_buf[((i2c) dev)->pos++] = ((i2c) dev)->mmio->DATA.reg;
+			return (msg_done(dev, 0));
+		}
+		((i2c) dev)->msg->rd_buf[((i2c) dev)->pos++] = ((i2c) dev)->mmio->DATA.reg;
+		return (pdFALSE);
+	}
+	if (flg & SERCOM_I2CM_INTFLAG_MB) {
+		if (st & (SERCOM_I2CM_STATUS_RXNACK | SERCOM_I2CM_STATUS_LENERR)) {
+#if DMAC_ON_CHIP == 1
+			if (((i2c) dev)->dma_phase) {
+				dmac_channel_abort_isr(((i2c) dev)->channel);
+			}
+#endif
+			stop(dev);
+			return (msg_done(dev, -ENACK));
+		}
+		if (((i2c) dev)->rd_phase || ((i2c) dev)->dma_phase) {
+			return (msg_done(dev, 0));
+		}
+		if (((i2c) dev)->pos < ((i2c) dev)->msg->wr_size) {
+			((i2c) dev)->mmio->DATA.reg = ((i2c) dev)->msg->wr_buf[((i2c) dev)->pos++];
+			return (pdFALSE);
+		}
+		if (((i2c) dev)->msg->rd_size > 0) {
+			start_rd(dev);
+			return (pdFALSE);
+		}
+		stop(dev);
+		return (msg_done(dev, 0));
+	}
+#endif
+	return (pdFALSE);
+}
+#endif
+
+#if DMAC_ON_CHIP == 1 && I2C_MASTER == 1
+/**
+ * dma_hndlr
+ */
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	disable_dmac_channel_intr(((i2c) dev)->channel);
+	if (intr != DMAC_TCMPL_INTR) {
+		stop(dev);
+		return (msg_done(dev, -EDMA));
+	}
+	if (((i2c) dev)->rd_phase) {
+		return (msg_done(dev, 0));
+	}
+	((i2c) dev)->mmio->INTENSET.reg = SERCOM_I2CM_INTENSET_MB;
+	return (pdFALSE);
+}
+#endif
+
+#if I2C_SLAVE == 1
+/**
+ * i2c_slave_watch
+ */
+int i2c_slave_watch(void *dev, int first, int size)
+{
+	int n;
+
+	if (first < 0 || size < 1 || first + size > ((i2c) dev)->slv_regs_size) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	taskENTER_CRITICAL();
+	if ((n = ((i2c) dev)->slv_range_cnt) == I2C_SLAVE_RANGES) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	((i2c) dev)->slv_range[n][0] = first;
+	((i2c) dev)->slv_range[n][1] = first + size - 1;
+	((i2c) dev)->slv_tsk = xTaskGetCurrentTaskHandle();
+	((i2c) dev)->slv_range_cnt++;
+	taskEXIT_CRITICAL();
+	return (n);
+}
+#endif
+
+#if I2C_SLAVE == 1
+/**
+ * i2c_slave_wait
+ */
+int i2c_slave_wait(void *dev, TickType_t tmo)
+{
+	uint32_t v;
+
+	if (pdFALSE == xTaskNotifyWait(0, 0xFFFFFFFF, &v, tmo)) {
+		return (-ETMO);
+	}
+	return (v);
+}
+#endif
+
+#if I2C_SLAVE == 1
+/**
+ * slv_hndlr
+ */
+static BaseType_t slv_hndlr(i2c dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	uint8_t flg = dev->slv_mmio->INTFLAG.reg;
+	uint8_t d;
+
+	if (flg & SERCOM_I2CS_INTFLAG_ERROR) {
+		dev->slv_mmio->INTFLAG.reg = SERCOM_I2CS_INTFLAG_ERROR;
+		dev->slv_mmio->STATUS.reg = SERCOM_I2CS_STATUS_BUSERR | SERCOM_I2CS_STATUS_COLL |
+		                            SERCOM_I2CS_STATUS_LOWTOUT | SERCOM_I2CS_STATUS_SEXTTOUT;
+	}
+	if (flg & SERCOM_I2CS_INTFLAG_PREC) {
+		dev->slv_mmio->INTFLAG.reg = SERCOM_I2CS_INTFLAG_PREC;
+		tsk_wkn = slv_wr_end(dev);
+	}
+	if (flg & SERCOM_I2CS_INTFLAG_AMATCH) {
+		tsk_wkn |= slv_wr_end(dev);
+		if (!(dev->slv_mmio->STATUS.reg & SERCOM_I2CS_STATUS_DIR)) {
+			dev->slv_ptr_set = FALSE;
+		}
+		dev->slv_first = TRUE;
+		dev->slv_mmio->CTRLB.reg = (dev->slv_mmio->CTRLB.reg & ~SERCOM_I2CS_CTRLB_ACKACT) |
+		                           SERCOM_I2CS_CTRLB_CMD(3);
+	}
+	if (flg & SERCOM_I2CS_INTFLAG_DRDY) {
+		if (dev->slv_mmio->STATUS.reg & SERCOM_I2CS_STATUS_DIR) {
+			if (!dev->slv_first && dev->slv_mmio->STATUS.reg & SERCOM_I2CS_STATUS_RXNACK) {
+				dev->slv_mmio->CTRLB.reg |= SERCOM_I2CS_CTRLB_CMD(2);
+			} else {
+				dev->slv_mmio->DATA.reg = dev->slv_regs[dev->slv_ptr];
+				if (++dev->slv_ptr == dev->slv_regs_size) {
+					dev->slv_ptr = 0;
+				}
+			}
+			dev->slv_first = FALSE;
+		} else {
+			d = dev->slv_mmio->DATA.reg;
+			if (!dev->slv_ptr_set) {
+				dev->slv_ptr = (d < dev->slv_regs_size) ? d : 0;
+				dev->slv_ptr_set = TRUE;
+			} else {
+				dev->slv_regs[dev->slv_ptr] = d;
+				for (int i = 0; i < dev->slv_range_cnt; i++) {
+					if (dev->slv_ptr >= dev->slv_range[i][0] && dev->slv_ptr <= dev->slv_range[i][1]) {
+						dev->slv_wr_mask |= 1 << i;
+					}
+				}
+				if (++dev->slv_ptr == dev->slv_regs_size) {
+					dev->slv_ptr = 0;
+				}
+			}
+		}
+	}
+	return (tsk_wkn);
+}
+#endif
+
+#if I2C_SLAVE == 1
+/**
+ * slv_wr_end
+ */
+static BaseType_t slv_wr_end(i2c dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+
+	if (dev->slv_wr_mask) {
+		xTaskNotifyFromISR(dev->slv_tsk, dev->slv_wr_mask, eSetBits, &tsk_wkn);
+		dev->slv_wr_mask = 0;
+	}
+	return (tsk_wkn);
+}
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * baud_reg
+ */
+static unsigned int baud_reg(i2c dev)
+{
+	long long baud;
+
+	if (dev->baudrate > 1000000) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	baud = dev->sercom_clock / dev->baudrate - 10 -
+	       ((long long) dev->sercom_clock * dev->rise_time) / 1000000000;
+	baud /= 2;
+	if (baud < 1 || baud > 255) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	return (SERCOM_I2CM_BAUD_BAUD(baud));
+}
+#endif
@@ -0,0 +1,242 @@
+/*
+ * i2c.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef I2C_H
+#define I2C_H
+
+#ifndef I2C_MASTER
+ #define I2C_MASTER 0
+#endif
+#ifndef I2C_SLAVE
+ #define I2C_SLAVE 0
+#endif
+#ifndef I2C_SLAVE_RANGES
+ #define I2C_SLAVE_RANGES 4
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+ #include "dmac.h"
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+enum i2c_mode {
+	I2C_MASTER_MODE,
+	I2C_SLAVE_MODE
+};
+
+enum i2c_standby {
+	I2C_STANDBY_ONDEMAND,
+	I2C_STANDBY_ACTIVE
+};
+
+enum i2c_addr_mode {
+	I2C_ADDR_MODE_MASK,
+	I2C_ADDR_MODE_2_ADDRS,
+        I2C_ADDR_MODE_RANGE
+};
+
+enum i2c_conf_pins_cmd {
+	I2C_CONF_PINS,
+	I2C_PINS_TO_PORT
+};
+
+struct i2c_msg {
+	int addr; // <SetIt> - 7-bit slave address.
+	const uint8_t *wr_buf; // <SetIt>
+	int wr_size; // <SetIt> - 0 if no write phase.
+	uint8_t *rd_buf; // <SetIt>
+	int rd_size; // <SetIt> - 0 if no read phase.
+	int err; // Result (0, -ENACK, -EHW, -EDMA, -ETMO, -EADDR).
+};
+
+typedef struct i2c_dsc *i2c;
+
+struct i2c_dsc {
+	int id; // <SetIt> [I2C_MASTER_MODE, I2C_SLAVE_MODE]
+	int baudrate; // <SetIt> - SCL frequency (max. 1 MHz). [I2C_MASTER_MODE, I2C_SLAVE_MODE]
+	int rise_time; // <SetIt> - SCL rise time [ns]. [I2C_MASTER_MODE]
+	int clk_gen; // <SetIt> - GCLK instance for sercom_clock. [I2C_MASTER_MODE, I2C_SLAVE_MODE]
+	int sercom_clock; // <SetIt> - GCLK frequency. [I2C_MASTER_MODE, I2C_SLAVE_MODE]
+	void (*conf_pins)(enum i2c_conf_pins_cmd); // <SetIt> [I2C_MASTER_MODE, I2C_SLAVE_MODE]
+        enum i2c_standby standby; // <SetIt> [I2C_MASTER_MODE]
+        boolean_t dma; // <SetIt> [I2C_MASTER_MODE]
+        enum i2c_addr_mode addr_mode; // <SetIt> [I2C_SLAVE_MODE]
+	int addr; // <SetIt> - 7-bit address. [I2C_SLAVE_MODE]
+	int addr_mask; // <SetIt> - Mask, second address or upper limit. [I2C_SLAVE_MODE]
+	uint8_t *slv_regs; // <SetIt> - Register file. [I2C_SLAVE_MODE]
+	int slv_regs_size; // <SetIt> - Register file size (max. 256). [I2C_SLAVE_MODE]
+#if DMAC_ON_CHIP == 1
+        dmac_channel channel;
+	int dmac_rx_trg_num;
+	int dmac_tx_trg_num;
+#endif
+        SercomI2cm *mmio;
+	unsigned int reg_ctrla;
+	unsigned int reg_ctrlb;
+	unsigned int reg_baud;
+        enum apb_bus_ins apb_bus_ins;
+	unsigned int apb_mask;
+	int clk_chn;
+        IRQn_Type irqn;
+        SemaphoreHandle_t mtx;
+        QueueHandle_t sig_que;
+	struct i2c_msg *msg;
+	int msg_cnt;
+	int pos;
+	boolean_t rd_phase;
+	boolean_t dma_phase;
+	int err;
+	enum i2c_mode mode;
+#if I2C_SLAVE == 1
+        SercomI2cs *slv_mmio;
+	unsigned int reg_addr;
+        TaskHandle_t slv_tsk;
+	uint8_t slv_range[I2C_SLAVE_RANGES][2];
+	int slv_range_cnt;
+	int slv_ptr;
+	boolean_t slv_ptr_set;
+	boolean_t slv_first;
+	uint32_t slv_wr_mask;
+#endif
+};
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * init_i2c
+ *
+ * Configure SERCOM instance as I2C in requested mode.
+ *
+ * @dev: I2C instance.
+ * @m: I2C mode (enum i2c_mode).
+ */
+void init_i2c(i2c dev, enum i2c_mode m);
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * enable_i2c
+ *
+ * Enable I2C (revert disable_i2c() function effects).
+ *
+ * @dev: I2C instance.
+ */
+void enable_i2c(void *dev);
+#endif
+
+#if I2C_MASTER == 1 || I2C_SLAVE == 1
+/**
+ * disable_i2c
+ *
+ * Disable I2C (switch SERCOM block and I2C DMAC channel off).
+ *
+ * @dev: I2C instance.
+ */
+void disable_i2c(void *dev);
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * i2c_submit
+ *
+ * Lock bus and start batch of transactions. Each transaction consists of
+ * optional write phase followed by optional read phase (repeated start).
+ * Transaction is finished by STOP, failed transaction does not stop batch.
+ * Final phases longer than 2 bytes (max. 255) are moved by DMA, ACK/NACK
+ * is generated by SERCOM smart mode. Function returns immediately, batch
+ * must be finished by i2c_wait() called by the same task (result is
+ * signaled by device queue, task notifications are not used). Batch
+ * containing transaction without write and read phase is not started,
+ * all its transactions fail with -EADDR.
+ *
+ * @dev: I2C instance.
+ * @msg: Array of transactions (must be valid until i2c_wait() returns).
+ * @n: Number of transactions.
+ */
+void i2c_submit(void *dev, struct i2c_msg *msg, int n);
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * i2c_wait
+ *
+ * Wait for end of batch started by i2c_submit() and unlock bus.
+ * Unfinished transactions are aborted after tmo.
+ *
+ * @dev: I2C instance.
+ * @tmo: Timeout in tick periods.
+ *
+ * Returns: 0 - success; error of first failed transaction
+ *          (-ENACK, -EHW, -EDMA, -ETMO, -EADDR).
+ */
+int i2c_wait(void *dev, TickType_t tmo);
+#endif
+
+#if I2C_MASTER == 1
+/**
+ * i2c_transfer
+ *
+ * Execute batch of transactions (i2c_submit() and i2c_wait()).
+ * Caller task is blocked during transfer.
+ *
+ * @dev: I2C instance.
+ * @msg: Array of transactions.
+ * @n: Number of transactions.
+ * @tmo: Timeout in tick periods.
+ *
+ * Returns: 0 - success; error of first failed transaction
+ *          (-ENACK, -EHW, -EDMA, -ETMO, -EADDR).
+ */
+int i2c_transfer(void *dev, struct i2c_msg *msg, int n, TickType_t tmo);
+#endif
+
+#if I2C_SLAVE == 1
+/**
+ * i2c_slave_watch
+ *
+ * Register range of slave register file. Task which calls this function
+ * is notified when I2C write transaction to this range is finished.
+ * Register file is accessed by host in common way: first written byte
+ * sets register pointer, next written bytes are stored and read bytes
+ * are loaded from pointer position (pointer is incremented and wraps
+ * at the end of register file).
+ *
+ * @dev: I2C instance.
+ * @first: First register.
+ * @size: Number of registers.
+ *
+ * Returns: Range number (bit number in i2c_slave_wait() mask).
+ */
+int i2c_slave_watch(void *dev, int first, int size);
+#endif
+
+#if I2C_SLAVE == 1
+/**
+ * i2c_slave_wait
+ *
+ * Wait for finished write transaction to registered ranges.
+ *
+ * @dev: I2C instance.
+ * @tmo: Timeout in tick periods.
+ *
+ * Returns: Bit mask of written ranges; -ETMO - no write in tmo time.
+ */
+int i2c_slave_wait(void *dev, TickType_t tmo);
+#endif
+
+#endif
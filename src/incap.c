@@ -0,0 +1,397 @@
+/*
+ * incap.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "port.h"
+#include "tc.h"
+#include "dmac.h"
+#include "evsys.h"
+#include "eic.h"
+#include "incap.h"
+#include <string.h>
+
+#if INCAP == 1
+
+#define START_POLLS 10000
+#define STATS_CHUNK 32
+
+
+static BaseType_t tc_isr_clbk(void *dev);
+static BaseType_t per_dma_hndlr(void *dev, enum dmac_intr intr);
+static BaseType_t pw_dma_hndlr(void *dev, enum dmac_intr intr);
+static dmac_channel conf_chn(incap dev, enum tc_dmac_trg trg, volatile uint16_t *src, uint16_t *buf,
+                             BaseType_t (*hndlr)(void *, enum dmac_intr));
+static unsigned int ring_total(incap dev, struct incap_ring *r);
+static int take(incap dev, uint16_t *per, uint16_t *pw, int max);
+static void drop(uint16_t *per, uint16_t *pw, int i, int n);
+static unsigned int isqrt(unsigned long long v);
+
+/**
+ * init_incap
+ */
+void init_incap(incap dev)
+{
+	int i;
+
+	if (dev->buf_size < 2 || dev->buf_size > 0x8000 || dev->buf_size & (dev->buf_size - 1) ||
+	    dev->tc.id < ID_TC3) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	dev->tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	dev->tc.prescaler = dev->prescaler;
+	dev->tc.wavegen = TC_WAVEGEN_NFRQ;
+	dev->tc.direction = TC_DIRECTION_UP;
+	dev->tc.chan_0_capt = TRUE;
+	dev->tc.chan_1_capt = TRUE;
+	dev->tc.capmode = CAPTURE_MODE_PPW;
+	dev->tc.ev_input = TRUE;
+	dev->tc.ev_inv = dev->inv;
+	dev->tc.int_enable_mask = TC_INTENSET_OVF | TC_INTENSET_ERR;
+	dev->tc.isr_clbk = tc_isr_clbk;
+	init_tc(&dev->tc);
+	tc_stop(&dev->tc);
+	// First period is measured from counter start.
+	dev->skip = 0;
+	dev->skip_act = TRUE;
+	dev->per.chn = conf_chn(dev, TC_DMAC_TRG_MC0, &dev->tc.mmio->COUNT16.CC[0].reg, dev->per_buf,
+	                        per_dma_hndlr);
+	dev->pw.chn = conf_chn(dev, TC_DMAC_TRG_MC1, &dev->tc.mmio->COUNT16.CC[1].reg, dev->pw_buf,
+	                       pw_dma_hndlr);
+	conf_pin(dev->pin, dev->port, PIN_FUNC_PERIPHERAL_A, PIN_FEAT_INPUT_BUFFER, PIN_FEAT_END);
+	dev->eintctl_pin.intr_mode = EINTCTL_INTR_HIGH;
+	dev->eintctl_pin.evout = TRUE;
+	conf_eintctl_pin(&dev->eintctl_pin);
+	if (NULL == (dev->ev_chn = alloc_evsys_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->ev_chn->gen = EVSYS_ID_GEN_EIC_EXTINT_0 + dev->eintctl_pin.n;
+	dev->ev_chn->path = EVSYS_PATH_ASYNCHRONOUS;
+	conf_evsys_channel(dev->ev_chn);
+	evsys_connect_user(dev->ev_chn, EVSYS_ID_USER_TC3_EVU + dev->tc.id - ID_TC3);
+	// Start in inactive phase so that first capture is period (CC0), not pulse width.
+	for (i = 0; i < START_POLLS; i++) {
+		if (get_pin_lev(dev->pin, dev->port) == ((dev->inv) ? HIGH : LOW)) {
+			break;
+		}
+	}
+	taskENTER_CRITICAL();
+	// Input active at start, first capture is pulse width (CC1) ending
+	// before first period.
+	dev->pw_ofs = (get_pin_lev(dev->pin, dev->port) == ((dev->inv) ? LOW : HIGH)) ? 1 : 0;
+	tc_trigger(&dev->tc);
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * incap_read
+ */
+int incap_read(incap dev, uint16_t *per, uint16_t *pw, int max)
+{
+	uint16_t tper[STATS_CHUNK], tpw[STATS_CHUNK];
+	int n, m = 0;
+
+	while (m < max) {
+		n = take(dev, tper, tpw, (max - m < STATS_CHUNK) ? max - m : STATS_CHUNK);
+		if (!n) {
+			break;
+		}
+		if (per) {
+			memcpy(per + m, tper, n * sizeof(uint16_t));
+		}
+		if (pw) {
+			memcpy(pw + m, tpw, n * sizeof(uint16_t));
+		}
+		m += n;
+	}
+	return (m);
+}
+
+/**
+ * incap_stats
+ */
+int incap_stats(incap dev, struct incap_stats *st)
+{
+	uint16_t per[STATS_CHUNK], pw[STATS_CHUNK];
+	unsigned long long sum = 0, sum_pw = 0, sum_sq = 0;
+	unsigned long long var;
+	boolean_t stall = dev->stall;
+	int n;
+
+	memset(st, 0, sizeof(struct incap_stats));
+	st->per_min = 0xFFFF;
+	while (st->n < dev->buf_size && (n = take(dev, per, pw, STATS_CHUNK))) {
+		for (int i = 0; i < n; i++) {
+			sum += per[i];
+			sum_pw += pw[i];
+			sum_sq += (unsigned int) per[i] * per[i];
+			if (per[i] < st->per_min) {
+				st->per_min = per[i];
+			}
+			if (per[i] > st->per_max) {
+				st->per_max = per[i];
+			}
+		}
+		st->n += n;
+	}
+	if (!st->n) {
+		st->per_min = 0;
+		return ((stall) ? -ETMO : -ENRDY);
+	}
+	st->per_avg = (sum + st->n / 2) / st->n;
+	st->freq = (sum) ? (unsigned long long) incap_tick_freq(dev) * 1000 * st->n / sum : 0;
+	st->duty = (sum) ? sum_pw * 1000 / sum : 0;
+	var = (sum_sq - sum * sum / st->n) / st->n;
+	st->jitter = isqrt(var);
+	return (0);
+}
+
+/**
+ * incap_tick_freq
+ */
+unsigned int incap_tick_freq(incap dev)
+{
+	return (tc_tick_freq(&dev->tc));
+}
+
+/**
+ * conf_chn
+ */
+static dmac_channel conf_chn(incap dev, enum tc_dmac_trg trg, volatile uint16_t *src, uint16_t *buf,
+                             BaseType_t (*hndlr)(void *, enum dmac_intr))
+{
+	dmac_channel chn;
+	DmacDescriptor *desc;
+
+	if (NULL == (chn = alloc_dmac_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	chn->dev = dev;
+	chn->hndlr = hndlr;
+	chn->trg_action = DMAC_TRG_ACTION_BEAT;
+	chn->trg_source = tc_dmac_trg_num(&dev->tc, trg);
+	chn->prio_level = DMAC_CHAN_PRIO_LEVEL3;
+	desc = chn->trans_desc;
+	// Circular buffer, block interrupt on every wrap.
+	desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_BLOCKACT_INT |
+	                   DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = dev->buf_size;
+	desc->SRCADDR.reg = (unsigned int) src;
+	desc->DSTADDR.reg = (unsigned int) (buf + dev->buf_size);
+	desc->DESCADDR.reg = (unsigned int) desc;
+	enable_dmac_transfer(chn);
+	return (chn);
+}
+
+/**
+ * ring_total
+ *
+ * Get number of values written by DMAC channel since start (modulo 2^32).
+ */
+static unsigned int ring_total(incap dev, struct incap_ring *r)
+{
+	unsigned int w;
+	int rem;
+	boolean_t cmpl;
+
+	do {
+		w = r->wraps;
+		rem = dmac_channel_remain(r->chn, &cmpl);
+		barrier();
+	} while (w != r->wraps);
+	if (cmpl) {
+		// Wrap interrupt not serviced yet.
+		w++;
+	}
+	return (w * dev->buf_size + ((rem) ? dev->buf_size - rem : 0));
+}
+
+/**
+ * take
+ *
+ * Copy up to max unread (period, pulse width) pairs.
+ */
+static int take(incap dev, uint16_t *per, uint16_t *pw, int max)
+{
+	unsigned int msk = dev->buf_size - 1;
+	unsigned int nper, npw, rd;
+	int n, ovw;
+
+	if (dev->stall) {
+		// Period captured after counter overflow is invalid.
+		dev->skip = dev->stall_at;
+		dev->skip_act = TRUE;
+		dev->stall = FALSE;
+		tc_clear_ovf_intr(&dev->tc);
+		tc_enable_ovf_intr(&dev->tc);
+	}
+	npw = ring_total(dev, &dev->pw);
+	nper = ring_total(dev, &dev->per);
+	// Phase is set at start from input level. Unequal capture counts prove
+	// it and correct edge which raced with counter start (compared count
+	// is always read later, so captures between reads cannot fake it).
+	if ((int) (npw - nper) > 0) {
+		dev->pw_ofs = 1;
+	} else if ((int) (nper - ring_total(dev, &dev->pw)) > 0) {
+		dev->pw_ofs = 0;
+	}
+	if (nper - dev->rd > msk) {
+		dev->lost_cnt += nper - dev->rd - msk;
+		dev->rd = nper - msk;
+	}
+	n = npw - dev->pw_ofs - dev->rd;
+	if (n > max) {
+		n = max;
+	}
+	if (n <= 0) {
+		return (0);
+	}
+	rd = dev->rd;
+	for (int i = 0; i < n; i++) {
+		per[i] = dev->per_buf[(rd + i) & msk];
+		pw[i] = dev->pw_buf[(rd + i + dev->pw_ofs) & msk];
+	}
+	dev->rd += n;
+	// Values overwritten during copy.
+	ovw = ring_total(dev, &dev->per) - msk - rd;
+	if (ovw > 0) {
+		if (ovw > n) {
+			ovw = n;
+		}
+		dev->lost_cnt += ovw;
+		drop(per, pw, 0, ovw);
+		n -= ovw;
+		rd += ovw;
+	}
+	if (dev->skip_act && (int) (dev->skip - rd) < n) {
+		if ((int) (dev->skip - rd) >= 0) {
+			drop(per, pw, dev->skip - rd, 1);
+			n--;
+		}
+		dev->skip_act = FALSE;
+	}
+	return (n);
+}
+
+/**
+ * drop
+ */
+static void drop(uint16_t *per, uint16_t *pw, int i, int n)
+{
+	memmove(per + i, per + i + n, (STATS_CHUNK - i - n) * sizeof(uint16_t));
+	memmove(pw + i, pw + i + n, (STATS_CHUNK - i - n) * sizeof(uint16_t));
+}
+
+/**
+ * isqrt
+ */
+static unsigned int isqrt(unsigned long long v)
+{
+	unsigned long long r = 0, b = 1ULL << 62;
+
+	while (b > v) {
+		b >>= 2;
+	}
+	while (b) {
+		if (v >= r + b) {
+			v -= r + b;
+			r = (r >> 1) + b;
+		} else {
+			r >>= 1;
+		}
+		b >>= 2;
+	}
+	return (r);
+}
+
+/**
+ * tc_isr_clbk
+ */
+static BaseType_t tc_isr_clbk(void *dev)
+{
+	incap d = TC_OWNER(dev, struct incap_dsc);
+	uint8_t flg = d->tc.mmio->COUNT16.INTFLAG.reg;
+
+	if (flg & TC_INTFLAG_OVF && !d->stall) {
+		// No edge in counter range; interrupt is enabled again by reader.
+		tc_disable_ovf_intr(&d->tc);
+		tc_clear_ovf_intr(&d->tc);
+		d->stall_at = ring_total(d, &d->per);
+		d->stall = TRUE;
+		d->stall_cnt++;
+	}
+	if (flg & TC_INTFLAG_ERR) {
+		tc_clear_err_intr(&d->tc);
+		d->err_cnt++;
+	}
+	return (pdFALSE);
+}
+
+/**
+ * per_dma_hndlr
+ */
+static BaseType_t per_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	incap d = dev;
+
+	clear_dmac_channel_intr(d->per.chn);
+	if (intr == DMAC_TCMPL_INTR) {
+		d->per.wraps++;
+	} else {
+		d->err_cnt++;
+	}
+	return (pdFALSE);
+}
+
+/**
+ * pw_dma_hndlr
+ */
+static BaseType_t pw_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	incap d = dev;
+
+	clear_dmac_channel_intr(d->pw.chn);
+	if (intr == DMAC_TCMPL_INTR) {
+		d->pw.wraps++;
+	} else {
+		d->err_cnt++;
+	}
+	return (pdFALSE);
+}
+
+#if TERMOUT == 1
+/**
+ * log_incap_stats
+ */
+void log_incap_stats(incap dev)
+{
+	msg(INF, "incap.c: tc=%d rd=%u pw_ofs=%d lost=%u stall=%u err=%u\n",
+	    dev->tc.id, dev->rd, dev->pw_ofs, dev->lost_cnt, dev->stall_cnt, dev->err_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * incap.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef INCAP_H
+#define INCAP_H
+
+#ifndef INCAP
+ #define INCAP 0
+#endif
+
+#if INCAP == 1
+
+#include "tc.h"
+#include "dmac.h"
+#include "evsys.h"
+#include "eic.h"
+
+typedef struct incap_dsc *incap;
+
+struct incap_ring {
+	dmac_channel chn;
+	volatile unsigned int wraps;
+};
+
+struct incap_dsc {
+	struct tc_timer_dsc tc; // <SetIt> - tc.id, tc.clk_gen, tc.clock_freq.
+	enum tc_prescaler prescaler; // <SetIt> - Longest period is 65535 prescaled ticks.
+	struct eintctl_pin_cfg eintctl_pin; // <SetIt> - EXTINT line n of input pin.
+	int pin; // <SetIt>
+	PortGroup *port; // <SetIt>
+	boolean_t inv; // <SetIt> - Period starts with falling edge.
+	uint16_t *per_buf; // <SetIt> - Period ring buffer.
+	uint16_t *pw_buf; // <SetIt> - Pulse width ring buffer.
+	int buf_size; // <SetIt> - Ring buffer size (items, power of two).
+	evsys_channel ev_chn;
+	struct incap_ring per;
+	struct incap_ring pw;
+	unsigned int rd;
+	int pw_ofs;
+	unsigned int skip;
+	boolean_t skip_act;
+	volatile unsigned int stall_at;
+	volatile boolean_t stall;
+	unsigned int lost_cnt;
+	unsigned int stall_cnt;
+	unsigned int err_cnt;
+};
+
+struct incap_stats {
+	int n; // Number of evaluated periods.
+	unsigned int freq; // Frequency [mHz].
+	unsigned int duty; // Duty cycle [0.1 %].
+	unsigned int per_min; // Shortest period [ticks].
+	unsigned int per_max; // Longest period [ticks].
+	unsigned int per_avg; // Average period [ticks].
+	unsigned int jitter; // Period standard deviation [ticks].
+};
+
+/**
+ * init_incap
+ *
+ * Connect input pin through EIC (level detection, event output) and EVSYS
+ * asynchronous channel to TC event input in period and pulse width capture
+ * mode. Captured CC0 (period) and CC1 (pulse width) values are moved to ring
+ * buffers by two circular DMAC channels, CPU is interrupted only on buffer
+ * wrap, counter overflow (no signal) and capture overrun.
+ *
+ * @dev: INCAP instance.
+ */
+void init_incap(incap dev);
+
+/**
+ * incap_read
+ *
+ * Read captured samples. Pulse width pw[i] starts with edge which ends
+ * period per[i]. If samples were overwritten by DMAC before read, oldest
+ * samples are skipped and counted in dev->lost_cnt.
+ *
+ * @dev: INCAP instance.
+ * @per: Period buffer (ticks) or NULL.
+ * @pw: Pulse width buffer (ticks) or NULL.
+ * @max: Buffers size (items).
+ *
+ * Returns: Number of samples.
+ */
+int incap_read(incap dev, uint16_t *per, uint16_t *pw, int max);
+
+/**
+ * incap_stats
+ *
+ * Consume captured samples (at most dev->buf_size) and evaluate statistics.
+ *
+ * @dev: INCAP instance.
+ * @st: Statistics.
+ *
+ * Returns: 0 - success; -ENRDY - no new sample; -ETMO - no signal (counter
+ *          overflow without capture).
+ */
+int incap_stats(incap dev, struct incap_stats *st);
+
+/**
+ * incap_tick_freq
+ *
+ * Returns: Capture counter frequency [Hz].
+ */
+unsigned int incap_tick_freq(incap dev);
+
+#if TERMOUT == 1
+/**
+ * log_incap_stats
+ */
+void log_incap_stats(incap dev);
+#endif
+#endif
+
+#endif
@@ -0,0 +1,517 @@
+/*
+ * mcp2515.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "dmac.h"
+#include "eic.h"
+#include "port.h"
+#include "spi.h"
+#include "spibus.h"
+#include "mcp2515.h"
+#include <string.h>
+
+#if MCP2515 == 1
+
+#define INS_RESET       0xC0
+#define INS_READ        0x03
+#define INS_WRITE       0x02
+#define INS_READ_RX     0x90
+#define INS_LOAD_TX     0x40
+#define INS_RTS         0x80
+#define INS_READ_STATUS 0xA0
+#define INS_BIT_MODIFY  0x05
+
+#define REG_CANSTAT  0x0E
+#define REG_CANCTRL  0x0F
+#define REG_CNF3     0x28
+#define REG_CANINTF  0x2C
+#define REG_EFLG     0x2D
+#define REG_TXB0CTRL 0x30
+#define REG_RXB0CTRL 0x60
+#define REG_RXF3SIDH 0x10
+#define REG_RXM0SIDH 0x20
+
+#define MODE_NORMAL 0x00
+#define MODE_CONFIG 0x80
+#define MODE_MASK   0xE0
+
+#define INTF_MERRF 0x80
+#define INTF_WAKIF 0x40
+#define INTF_ERRIF 0x20
+
+#define STAT_RX0IF  0x01
+#define STAT_RX1IF  0x02
+
+static mcp2515 dev_list;
+
+static void mcp2515_tsk(void *p);
+static BaseType_t isr_clbk(unsigned short intflg);
+static int drain(mcp2515 dev);
+static int load_tx(mcp2515 dev, uint8_t st);
+static void push_rx(mcp2515 dev, const uint8_t *r);
+static int xact(mcp2515 dev, const uint8_t *tx, uint8_t *rx, int n);
+static int read_reg(mcp2515 dev, uint8_t addr, uint8_t *v);
+static int bit_modify(mcp2515 dev, uint8_t addr, uint8_t mask, uint8_t v);
+static int set_mode(mcp2515 dev, uint8_t mode);
+static void enc_id(uint8_t *p, unsigned int id, boolean_t ext);
+static unsigned int arb_key(const struct mcp2515_frame *frm);
+
+/**
+ * add_mcp2515_dev
+ */
+void add_mcp2515_dev(mcp2515 dev)
+{
+	uint8_t b[6];
+	int tq, brp = -1, ps1, ps2, prop;
+
+	if (dev->bdev == NULL || dev->eintctl_pin.intr_mode != EINTCTL_INTR_LOW) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (tq = 16; tq >= 8; tq--) {
+		if (dev->osc_freq % (2 * dev->bitrate * tq) == 0) {
+			brp = dev->osc_freq / (2 * dev->bitrate * tq) - 1;
+			break;
+		}
+	}
+	if (brp < 0 || brp > 63) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	ps2 = (tq / 4 < 2) ? 2 : tq / 4;
+	ps1 = (tq - 1 - ps2 + 1) / 2;
+	prop = tq - 1 - ps1 - ps2;
+	dev->rx_head = dev->rx_tail = 0;
+	dev->rx_tsk = NULL;
+	dev->tx_cnt = 0;
+	spibus_acquire(dev->bdev);
+	b[0] = INS_RESET;
+	xact(dev, b, NULL, 1);
+	spibus_release(dev->bdev);
+	vTaskDelay(10 / portTICK_PERIOD_MS);
+	spibus_acquire(dev->bdev);
+	b[0] = INS_WRITE;
+	b[1] = REG_CNF3;
+	b[2] = ps2 - 1;
+	b[3] = 0x80 | (ps1 - 1) << 3 | (prop - 1);
+	b[4] = brp;
+	b[5] = 0xFF & ~INTF_WAKIF;
+	if (xact(dev, b, NULL, 6) || bit_modify(dev, REG_RXB0CTRL, 0x04, 0x04) ||
+	    set_mode(dev, MODE_NORMAL)) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	spibus_release(dev->bdev);
+	conf_pin(dev->int_pin, dev->int_port, PIN_FUNC_PERIPHERAL_A,
+	         PIN_FEAT_INPUT_BUFFER, PIN_FEAT_PULL_UP, PIN_FEAT_END);
+	reg_eintctl_isr_clbk(isr_clbk);
+	taskENTER_CRITICAL();
+	if (dev_list) {
+		mcp2515 d = dev_list;
+		while (d->next) {
+			d = d->next;
+		}
+		d->next = dev;
+	} else {
+		dev_list = dev;
+	}
+	dev->next = NULL;
+	taskEXIT_CRITICAL();
+	if (pdPASS != xTaskCreate(mcp2515_tsk, dev->tsk_nm, MCP2515_TASK_STACK_SIZE, dev,
+				  MCP2515_TASK_PRIO, &dev->tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	conf_eintctl_pin(&dev->eintctl_pin);
+	// Task drains controller and enables INT line interrupt.
+	xTaskNotifyGive(dev->tsk_hndl);
+}
+
+/**
+ * mcp2515_send
+ */
+int mcp2515_send(mcp2515 dev, const struct mcp2515_frame *frm)
+{
+	unsigned int key = arb_key(frm);
+	int i;
+
+	taskENTER_CRITICAL();
+	if (dev->tx_cnt == MCP2515_TX_QUE_SIZE) {
+		taskEXIT_CRITICAL();
+		return (-EBFOV);
+	}
+	for (i = dev->tx_cnt; i > 0 && arb_key(&dev->tx_que[i - 1]) > key; i--) {
+		dev->tx_que[i] = dev->tx_que[i - 1];
+	}
+	dev->tx_que[i] = *frm;
+	dev->tx_cnt++;
+	taskEXIT_CRITICAL();
+	xTaskNotifyGive(dev->tsk_hndl);
+	return (0);
+}
+
+/**
+ * mcp2515_recv
+ */
+int mcp2515_recv(mcp2515 dev, struct mcp2515_frame *frm, TickType_t tmo)
+{
+	while (dev->rx_head == dev->rx_tail) {
+		dev->rx_tsk = xTaskGetCurrentTaskHandle();
+		if (dev->rx_head != dev->rx_tail) {
+			break;
+		}
+		if (!ulTaskNotifyTake(pdTRUE, tmo)) {
+			dev->rx_tsk = NULL;
+			return (-ETMO);
+		}
+	}
+	dev->rx_tsk = NULL;
+	*frm = dev->rx_ring[dev->rx_tail & (MCP2515_RX_RING_SIZE - 1)];
+	barrier();
+	dev->rx_tail++;
+	return (0);
+}
+
+/**
+ * mcp2515_set_filter
+ */
+int mcp2515_set_filter(mcp2515 dev, int n, unsigned int id, boolean_t ext)
+{
+	uint8_t b[6];
+	int ret;
+
+	if (n < 0 || n > 5) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	b[0] = INS_WRITE;
+	b[1] = (n < 3) ? 4 * n : REG_RXF3SIDH + 4 * (n - 3);
+	enc_id(b + 2, id, ext);
+	spibus_acquire(dev->bdev);
+	if (!(ret = set_mode(dev, MODE_CONFIG)) && !(ret = xact(dev, b, NULL, 6))) {
+		ret = set_mode(dev, MODE_NORMAL);
+	}
+	spibus_release(dev->bdev);
+	return (ret);
+}
+
+/**
+ * mcp2515_set_mask
+ */
+int mcp2515_set_mask(mcp2515 dev, int n, unsigned int mask, boolean_t ext)
+{
+	uint8_t b[6];
+	int ret;
+
+	if (n < 0 || n > 1) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	b[0] = INS_WRITE;
+	b[1] = REG_RXM0SIDH + 4 * n;
+	enc_id(b + 2, mask, ext);
+	spibus_acquire(dev->bdev);
+	if (!(ret = set_mode(dev, MODE_CONFIG)) && !(ret = xact(dev, b, NULL, 6))) {
+		ret = set_mode(dev, MODE_NORMAL);
+	}
+	spibus_release(dev->bdev);
+	return (ret);
+}
+
+/**
+ * mcp2515_tsk
+ */
+static void mcp2515_tsk(void *p)
+{
+	mcp2515 dev = p;
+	unsigned int head;
+	TaskHandle_t t;
+	int err;
+
+	while (TRUE) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		head = dev->rx_head;
+		spibus_acquire(dev->bdev);
+		do {
+			if ((err = drain(dev))) {
+				dev->spi_err = err;
+				break;
+			}
+		} while (!get_pin_lev(dev->int_pin, dev->int_port));
+		spibus_release(dev->bdev);
+		eintctl_intr_clear(&dev->eintctl_pin);
+		eintctl_intr_enable(&dev->eintctl_pin);
+		if (head != dev->rx_head && (t = dev->rx_tsk)) {
+			xTaskNotifyGive(t);
+		}
+	}
+}
+
+/**
+ * isr_clbk
+ */
+static BaseType_t isr_clbk(unsigned short intflg)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+
+	for (mcp2515 d = dev_list; d; d = d->next) {
+		if (intflg & (1 << d->eintctl_pin.n) && is_eintctl_intr_enabled(&d->eintctl_pin)) {
+			eintctl_intr_disable(&d->eintctl_pin);
+			eintctl_intr_clear(&d->eintctl_pin);
+			d->intr_cnt++;
+			vTaskNotifyGiveFromISR(d->tsk_hndl, &tsk_wkn);
+		}
+	}
+	return (tsk_wkn);
+}
+
+/**
+ * drain
+ *
+ * Read status, drain RX buffers, acknowledge finished transmissions,
+ * load free TX buffers and clear error flags (bus acquired).
+ */
+static int drain(mcp2515 dev)
+{
+	uint8_t b[14], st, m;
+	int ret;
+
+	b[0] = INS_READ_STATUS;
+	if ((ret = xact(dev, b, b, 2))) {
+		return (ret);
+	}
+	st = b[1];
+	for (int n = 0; n < 2; n++) {
+		if (st & (STAT_RX0IF << n)) {
+			b[0] = INS_READ_RX | n << 2;
+			if ((ret = xact(dev, b, b, 14))) {
+				return (ret);
+			}
+			push_rx(dev, b + 1);
+		}
+	}
+	m = (st >> 1 & 0x04) | (st >> 2 & 0x08) | (st >> 3 & 0x10);
+	if (m) {
+		if ((ret = bit_modify(dev, REG_CANINTF, m, 0))) {
+			return (ret);
+		}
+		dev->tx_cnt_all += (m >> 2 & 1) + (m >> 3 & 1) + (m >> 4 & 1);
+	}
+	if (dev->tx_cnt && (ret = load_tx(dev, st))) {
+		return (ret);
+	}
+	if (!(st & (STAT_RX0IF | STAT_RX1IF))) {
+		if ((ret = read_reg(dev, REG_CANINTF, &m))) {
+			return (ret);
+		}
+		if (m & (INTF_MERRF | INTF_WAKIF | INTF_ERRIF)) {
+			if ((ret = read_reg(dev, REG_EFLG, &st))) {
+				return (ret);
+			}
+			if (st & 0xC0) {
+				dev->hw_ovf_cnt++;
+				if ((ret = bit_modify(dev, REG_EFLG, 0xC0, 0))) {
+					return (ret);
+				}
+			}
+			if (m & (INTF_MERRF | INTF_ERRIF)) {
+				dev->err_cnt++;
+			}
+			return (bit_modify(dev, REG_CANINTF, INTF_MERRF | INTF_WAKIF | INTF_ERRIF, 0));
+		}
+	}
+	return (0);
+}
+
+/**
+ * load_tx
+ *
+ * Load queued frames to free TX buffers in priority order and request
+ * transmission by single RTS (earlier loaded frame gets higher TXP).
+ */
+static int load_tx(mcp2515 dev, uint8_t st)
+{
+	struct mcp2515_frame frm;
+	uint8_t b[14], rts = 0;
+	int k = 0, ret;
+
+	for (int n = 0; n < 3; n++) {
+		if (st & (0x04 << 2 * n)) {
+			continue;
+		}
+		taskENTER_CRITICAL();
+		if (!dev->tx_cnt) {
+			taskEXIT_CRITICAL();
+			break;
+		}
+		frm = dev->tx_que[0];
+		memmove(dev->tx_que, dev->tx_que + 1, --dev->tx_cnt * sizeof(struct mcp2515_frame));
+		taskEXIT_CRITICAL();
+		if ((ret = bit_modify(dev, REG_TXB0CTRL + 0x10 * n, 0x03, 3 - k))) {
+			return (ret);
+		}
+		b[0] = INS_LOAD_TX | n << 1;
+		enc_id(b + 1, frm.id, frm.ext);
+		b[5] = (frm.dlc & 0x0F) | ((frm.rtr) ? 0x40 : 0);
+		memcpy(b + 6, frm.data, 8);
+		if ((ret = xact(dev, b, NULL, (frm.rtr) ? 6 : 6 + ((frm.dlc > 8) ? 8 : frm.dlc)))) {
+			return (ret);
+		}
+		rts |= 1 << n;
+		k++;
+	}
+	if (rts) {
+		b[0] = INS_RTS | rts;
+		return (xact(dev, b, NULL, 1));
+	}
+	return (0);
+}
+
+/**
+ * push_rx
+ */
+static void push_rx(mcp2515 dev, const uint8_t *r)
+{
+	struct mcp2515_frame *f;
+
+	if (dev->rx_head - dev->rx_tail == MCP2515_RX_RING_SIZE) {
+		dev->rx_ovf_cnt++;
+		return;
+	}
+	f = &dev->rx_ring[dev->rx_head & (MCP2515_RX_RING_SIZE - 1)];
+	if (r[1] & 0x08) {
+		f->ext = TRUE;
+		f->id = r[0] << 21 | (r[1] & 0xE0) << 13 | (r[1] & 0x03) << 16 | r[2] << 8 | r[3];
+		f->rtr = (r[4] & 0x40) ? TRUE : FALSE;
+	} else {
+		f->ext = FALSE;
+		f->id = r[0] << 3 | r[1] >> 5;
+		f->rtr = (r[1] & 0x10) ? TRUE : FALSE;
+	}
+	f->dlc = r[4] & 0x0F;
+	memcpy(f->data, r + 5, 8);
+	barrier();
+	dev->rx_head++;
+	dev->rx_cnt++;
+}
+
+/**
+ * xact
+ */
+static int xact(mcp2515 dev, const uint8_t *tx, uint8_t *rx, int n)
+{
+	int ret;
+
+	spibus_cs(dev->bdev, TRUE);
+	ret = spi_transfer(dev->bdev->bus->spi, tx, rx, n);
+	spibus_cs(dev->bdev, FALSE);
+	return (ret);
+}
+
+/**
+ * read_reg
+ */
+static int read_reg(mcp2515 dev, uint8_t addr, uint8_t *v)
+{
+	uint8_t b[3] = {INS_READ, addr, 0xFF};
+	int ret;
+
+	if (!(ret = xact(dev, b, b, 3))) {
+		*v = b[2];
+	}
+	return (ret);
+}
+
+/**
+ * bit_modify
+ */
+static int bit_modify(mcp2515 dev, uint8_t addr, uint8_t mask, uint8_t v)
+{
+	uint8_t b[4] = {INS_BIT_MODIFY, addr, mask, v};
+
+	return (xact(dev, b, NULL, 4));
+}
+
+/**
+ * set_mode
+ */
+static int set_mode(mcp2515 dev, uint8_t mode)
+{
+	uint8_t v;
+	int ret;
+
+	if ((ret = bit_modify(dev, REG_CANCTRL, MODE_MASK, mode))) {
+		return (ret);
+	}
+	for (int i = 0; i < 10; i++) {
+		if ((ret = read_reg(dev, REG_CANSTAT, &v))) {
+			return (ret);
+		}
+		if ((v & MODE_MASK) == mode) {
+			return (0);
+		}
+	}
+	return (-EHW);
+}
+
+/**
+ * enc_id
+ */
+static void enc_id(uint8_t *p, unsigned int id, boolean_t ext)
+{
+	if (ext) {
+		p[0] = id >> 21;
+		p[1] = (id >> 13 & 0xE0) | 0x08 | (id >> 16 & 0x03);
+		p[2] = id >> 8;
+		p[3] = id;
+	} else {
+		p[0] = id >> 3;
+		p[1] = id << 5;
+		p[2] = 0;
+		p[3] = 0;
+	}
+}
+
+/**
+ * arb_key
+ */
+static unsigned int arb_key(const struct mcp2515_frame *frm)
+{
+	return ((frm->ext) ? frm->id : frm->id << 18);
+}
+
+#if TERMOUT == 1
+/**
+ * log_mcp2515_stats
+ */
+void log_mcp2515_stats(mcp2515 dev)
+{
+	msg(INF, "mcp2515.c: <%s> rx=%u tx=%u intr=%u rx_ovf=%u hw_ovf=%u err=%u spi_err=%d\n",
+	    dev->tsk_nm, dev->rx_cnt, dev->tx_cnt_all, dev->intr_cnt, dev->rx_ovf_cnt,
+	    dev->hw_ovf_cnt, dev->err_cnt, dev->spi_err);
+}
+#endif
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * mcp2515.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MCP2515_H
+#define MCP2515_H
+
+#ifndef MCP2515
+ #define MCP2515 0
+#endif
+#ifndef MCP2515_RX_RING_SIZE
+ #define MCP2515_RX_RING_SIZE 32
+#endif
+#if (MCP2515_RX_RING_SIZE & (MCP2515_RX_RING_SIZE - 1)) != 0
+ #error "MCP2515_RX_RING_SIZE must be power of two"
+#endif
+#ifndef MCP2515_TX_QUE_SIZE
+ #define MCP2515_TX_QUE_SIZE 16
+#endif
+
+#if MCP2515 == 1
+
+#include "eic.h"
+#include "port.h"
+#include "spibus.h"
+
+struct mcp2515_frame {
+	unsigned int id;
+	boolean_t ext;
+	boolean_t rtr;
+	uint8_t dlc;
+	uint8_t data[8];
+};
+
+typedef struct mcp2515_dsc *mcp2515;
+
+struct mcp2515_dsc {
+	spibus_dev bdev; // <SetIt> - Registered SPI bus device.
+	struct eintctl_pin_cfg eintctl_pin; // <SetIt> - INT pin (EINTCTL_INTR_LOW).
+	int int_pin; // <SetIt>
+	PortGroup *int_port; // <SetIt>
+	int osc_freq; // <SetIt> - Controller oscillator frequency.
+	int bitrate; // <SetIt>
+	const char *tsk_nm; // <SetIt>
+	TaskHandle_t tsk_hndl;
+	struct mcp2515_frame rx_ring[MCP2515_RX_RING_SIZE];
+	volatile unsigned int rx_head;
+	volatile unsigned int rx_tail;
+	TaskHandle_t volatile rx_tsk;
+	struct mcp2515_frame tx_que[MCP2515_TX_QUE_SIZE];
+	int tx_cnt;
+	unsigned int rx_cnt;
+	unsigned int tx_cnt_all;
+	unsigned int rx_ovf_cnt;
+	unsigned int hw_ovf_cnt;
+	unsigned int err_cnt;
+	unsigned int intr_cnt;
+	int spi_err;
+	struct mcp2515_dsc *next;
+};
+
+/**
+ * add_mcp2515_dev
+ *
+ * Reset and configure CAN controller (normal mode, all frames accepted),
+ * register INT pin interrupt and create controller task.
+ * Must be called from task (SPI transfers block caller).
+ *
+ * @dev: Controller instance.
+ */
+void add_mcp2515_dev(mcp2515 dev);
+
+/**
+ * mcp2515_send
+ *
+ * Queue frame for transmission. Queue is ordered by CAN arbitration
+ * priority (lower identifier first), frames with equal identifier are
+ * sent in FIFO order. Up to 3 frames are loaded into controller buffers.
+ *
+ * @dev: Controller instance.
+ * @frm: Frame.
+ *
+ * Returns: 0 - success; -EBFOV - transmit queue full.
+ */
+int mcp2515_send(mcp2515 dev, const struct mcp2515_frame *frm);
+
+/**
+ * mcp2515_recv
+ *
+ * Get received frame from lock-free single consumer ring.
+ *
+ * @dev: Controller instance.
+ * @frm: Frame.
+ * @tmo: Timeout in ticks.
+ *
+ * Returns: 0 - success; -ETMO - no frame received.
+ */
+int mcp2515_recv(mcp2515 dev, struct mcp2515_frame *frm, TickType_t tmo);
+
+/**
+ * mcp2515_set_filter
+ *
+ * Set acceptance filter (controller is shortly switched to configuration
+ * mode). Filters 0-1 belong to mask 0 and RX buffer 0, filters 2-5 belong
+ * to mask 1 and RX buffer 1.
+ *
+ * @dev: Controller instance.
+ * @n: Filter number (0 - 5).
+ * @id: Identifier.
+ * @ext: Extended identifier.
+ *
+ * Returns: 0 - success; -EHW - mode change failed; -EDMA - dma error.
+ */
+int mcp2515_set_filter(mcp2515 dev, int n, unsigned int id, boolean_t ext);
+
+/**
+ * mcp2515_set_mask
+ *
+ * Set acceptance mask (controller is shortly switched to configuration
+ * mode). Mask 0 - all frames accepted.
+ *
+ * @dev: Controller instance.
+ * @n: Mask number (0 - 1).
+ * @mask: Identifier mask.
+ * @ext: Mask includes extended identifier bits.
+ *
+ * Returns: 0 - success; -EHW - mode change failed; -EDMA - dma error.
+ */
+int mcp2515_set_mask(mcp2515 dev, int n, unsigned int mask, boolean_t ext);
+
+#if TERMOUT == 1
+/**
+ * log_mcp2515_stats
+ */
+void log_mcp2515_stats(mcp2515 dev);
+#endif
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * pwave.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "tc.h"
+#include "dmac.h"
+#include "pwave.h"
+
+#if PWAVE == 1
+
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr);
+
+/**
+ * init_pwave
+ */
+void init_pwave(pwave dev)
+{
+	unsigned int top;
+	int i;
+
+	if (0 > (i = tc_fit_prescaler(dev->tc.clock_freq, 1, dev->sample_freq, &top)) || top == 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (NULL == (dev->sig_que = xQueueCreate(1, sizeof(uint8_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	dev->tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	dev->tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	dev->tc.prescaler = i;
+	dev->tc.wavegen = TC_WAVEGEN_MFRQ;
+	dev->tc.direction = TC_DIRECTION_UP;
+	dev->tc.cc0 = top - 1;
+	init_tc(&dev->tc);
+	tc_stop(&dev->tc);
+	if (NULL == (dev->channel = alloc_dmac_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->channel->dev = dev;
+	dev->channel->hndlr = dma_hndlr;
+	dev->channel->trg_action = DMAC_TRG_ACTION_BEAT;
+	dev->channel->trg_source = tc_dmac_trg_num(&dev->tc, TC_DMAC_TRG_OVF);
+	dev->channel->prio_level = DMAC_CHAN_PRIO_LEVEL3;
+}
+
+/**
+ * pwave_play
+ */
+int pwave_play(pwave dev, const unsigned int *tbl, int size, boolean_t loop)
+{
+	DmacDescriptor *desc = dev->channel->trans_desc;
+	uint8_t er;
+
+	if (size < 1 || size > 0xFFFF) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_WORD | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = size;
+	desc->SRCADDR.reg = (unsigned int) (tbl + size);
+	switch (dev->reg) {
+	case PWAVE_REG_OUT    :
+		desc->DSTADDR.reg = (unsigned int) &dev->port->OUT.reg;
+		break;
+	case PWAVE_REG_OUTCLR :
+		desc->DSTADDR.reg = (unsigned int) &dev->port->OUTCLR.reg;
+		break;
+	case PWAVE_REG_OUTSET :
+		desc->DSTADDR.reg = (unsigned int) &dev->port->OUTSET.reg;
+		break;
+	case PWAVE_REG_OUTTGL :
+		desc->DSTADDR.reg = (unsigned int) &dev->port->OUTTGL.reg;
+		break;
+	}
+	desc->DESCADDR.reg = (loop) ? (unsigned int) desc : 0;
+	while (pdTRUE == xQueueReceive(dev->sig_que, &er, 0));
+	tc_set_cnt(&dev->tc, 0);
+	enable_dmac_transfer(dev->channel);
+	tc_trigger(&dev->tc);
+	if (loop) {
+		return (0);
+	}
+	xQueueReceive(dev->sig_que, &er, portMAX_DELAY);
+	tc_stop(&dev->tc);
+	if (er) {
+		reset_dmac_channel(dev->channel);
+		return (-EDMA);
+	}
+	return (0);
+}
+
+/**
+ * pwave_stop
+ */
+int pwave_stop(pwave dev)
+{
+	tc_stop(&dev->tc);
+	return (dmac_channel_abort(dev->channel));
+}
+
+/**
+ * pwave_compile
+ */
+int pwave_compile(pwave dev, unsigned int *tbl, int tbl_size, const uint8_t *bits, int nbits,
+                  const struct pwave_code *code)
+{
+	const unsigned int *smp;
+	unsigned int lev, out;
+	int n = 0;
+
+	if (nbits * code->samples > tbl_size) {
+		return (-EBFOV);
+	}
+	out = dev->port->OUT.reg;
+	for (int i = 0; i < nbits; i++) {
+		smp = (bits[i / 8] & (0x80 >> (i % 8))) ? code->one : code->zero;
+		for (int j = 0; j < code->samples; j++) {
+			lev = smp[j] & code->pin_msk;
+			switch (dev->reg) {
+			case PWAVE_REG_OUT    :
+				out = (out & ~code->pin_msk) | lev;
+				tbl[n++] = out;
+				break;
+			case PWAVE_REG_OUTCLR :
+				tbl[n++] = ~lev & code->pin_msk;
+				break;
+			case PWAVE_REG_OUTSET :
+				tbl[n++] = lev;
+				break;
+			case PWAVE_REG_OUTTGL :
+				tbl[n++] = (out ^ lev) & code->pin_msk;
+				out = (out & ~code->pin_msk) | lev;
+				break;
+			}
+		}
+	}
+	return (n);
+}
+
+/**
+ * dma_hndlr
+ */
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	uint8_t er = (intr == DMAC_TCMPL_INTR) ? 0 : 1;
+
+	disable_dmac_channel_intr(((pwave) dev)->channel);
+	xQueueSendFromISR(((pwave) dev)->sig_que, &er, &tsk_wkn);
+	return (tsk_wkn);
+}
+#endif
@@ -0,0 +1,114 @@
+/*
+ * pwave.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PWAVE_H
+#define PWAVE_H
+
+#ifndef PWAVE
+ #define PWAVE 0
+#endif
+
+#if PWAVE == 1
+
+#include "tc.h"
+#include "dmac.h"
+
+enum pwave_reg {
+	PWAVE_REG_OUT,
+	PWAVE_REG_OUTCLR,
+	PWAVE_REG_OUTSET,
+	PWAVE_REG_OUTTGL
+};
+
+struct pwave_code {
+	unsigned int pin_msk; // Pins driven by code.
+	int samples; // Number of samples per bit.
+	const unsigned int *zero; // Pins levels of bit 0 samples.
+	const unsigned int *one; // Pins levels of bit 1 samples.
+};
+
+typedef struct pwave_dsc *pwave;
+
+struct pwave_dsc {
+	int sample_freq; // <SetIt> - Table sample rate [Hz].
+	PortGroup *port; // <SetIt>
+	enum pwave_reg reg; // <SetIt> - PORT register written by DMA.
+	struct tc_timer_dsc tc; // <SetIt> - tc.id, tc.clk_gen, tc.clock_freq.
+	dmac_channel channel;
+	QueueHandle_t sig_que;
+};
+
+/**
+ * init_pwave
+ *
+ * Configure TC instance as sample clock and allocate DMAC channel which moves
+ * samples from table to PORT group register.
+ *
+ * @dev: PWAVE instance.
+ */
+void init_pwave(pwave dev);
+
+/**
+ * pwave_play
+ *
+ * Stream table of 32-bit PORT register values, one value per sample period.
+ * Caller task is blocked until table is played (loop FALSE). In loop mode
+ * table is repeated until pwave_stop() is called and function returns
+ * immediately.
+ *
+ * @dev: PWAVE instance.
+ * @tbl: Table of values (must be valid until playback ends).
+ * @size: Number of table items (1 - 65535).
+ * @loop: Repeat table.
+ *
+ * Returns: 0 - success; -EDMA - dma error.
+ */
+int pwave_play(pwave dev, const unsigned int *tbl, int size, boolean_t loop);
+
+/**
+ * pwave_stop
+ *
+ * Stop playback.
+ *
+ * @dev: PWAVE instance.
+ *
+ * Returns: Number of samples output in current table pass.
+ */
+int pwave_stop(pwave dev);
+
+/**
+ * pwave_compile
+ *
+ * Compile bit stream into table of values for PORT register dev->reg.
+ * Every bit is expanded to code->samples samples. Pins levels present at
+ * call time are used as initial state (PWAVE_REG_OUT and PWAVE_REG_OUTTGL).
+ *
+ * @dev: PWAVE instance.
+ * @tbl: Table buffer.
+ * @tbl_size: Table buffer size (items).
+ * @bits: Bit stream (MSB of first byte is sent first).
+ * @nbits: Number of bits.
+ * @code: Bit code.
+ *
+ * Returns: Number of table items; -EBFOV - table buffer too small.
+ */
+int pwave_compile(pwave dev, unsigned int *tbl, int tbl_size, const uint8_t *bits, int nbits,
+                  const struct pwave_code *code);
+#endif
+
+#endif
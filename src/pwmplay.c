@@ -0,0 +1,239 @@
+/*
+ * pwmplay.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "tc.h"
+#include "dmac.h"
+#include "pwmplay.h"
+
+#if PWMPLAY == 1
+
+static void start(pwmplay dev);
+static void conf_desc(pwmplay dev, DmacDescriptor *desc, const uint16_t *src, int size);
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr);
+static BaseType_t tc_isr_clbk(void *dev);
+
+/**
+ * init_pwmplay
+ */
+void init_pwmplay(pwmplay dev)
+{
+	unsigned int top;
+	int i;
+
+	if (0 > (i = tc_fit_prescaler(dev->tc.clock_freq, 1, dev->pwm_freq, &top)) || top < 2) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (NULL == (dev->sig_que = xQueueCreate(1, sizeof(uint8_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	dev->top = top - 1;
+	dev->tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	dev->tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	dev->tc.prescaler = i;
+	dev->tc.wavegen = TC_WAVEGEN_MPWM;
+	dev->tc.direction = TC_DIRECTION_UP;
+	dev->tc.cc0 = dev->top;
+	dev->tc.cc1 = 0;
+	dev->tc.chan_1_wave_inv = dev->inv;
+	dev->tc.conf_pins = dev->conf_pins;
+	dev->tc.isr_clbk = tc_isr_clbk;
+	init_tc(&dev->tc);
+	tc_stop(&dev->tc);
+	if (NULL == (dev->channel = alloc_dmac_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->channel->dev = dev;
+	dev->channel->hndlr = dma_hndlr;
+	dev->channel->trg_action = DMAC_TRG_ACTION_BEAT;
+	dev->channel->trg_source = tc_dmac_trg_num(&dev->tc, TC_DMAC_TRG_OVF);
+	dev->channel->prio_level = DMAC_CHAN_PRIO_LEVEL3;
+}
+
+/**
+ * pwmplay_top
+ */
+unsigned int pwmplay_top(pwmplay dev)
+{
+	return (dev->top);
+}
+
+/**
+ * pwmplay_play
+ */
+int pwmplay_play(pwmplay dev, const uint16_t *tbl, int size, boolean_t loop)
+{
+	DmacDescriptor *desc = dev->channel->trans_desc;
+	uint8_t er;
+
+	if (size < 1 || size > 0xFFFF) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->stream = FALSE;
+	conf_desc(dev, desc, tbl, size);
+	desc->DESCADDR.reg = (loop) ? (unsigned int) desc : 0;
+	while (pdTRUE == xQueueReceive(dev->sig_que, &er, 0));
+	start(dev);
+	if (loop) {
+		return (0);
+	}
+	xQueueReceive(dev->sig_que, &er, portMAX_DELAY);
+	tc_stop(&dev->tc);
+	tc_disable_ovf_intr(&dev->tc);
+	tc_set_oneshot(&dev->tc, FALSE);
+	if (er) {
+		reset_dmac_channel(dev->channel);
+		return (-EDMA);
+	}
+	return (0);
+}
+
+/**
+ * pwmplay_stream
+ */
+void pwmplay_stream(pwmplay dev, uint16_t *buf, int size)
+{
+	DmacDescriptor *desc = dev->channel->trans_desc;
+
+	if (size < 2 || size > 0xFFFE || size & 1 || !dev->refill) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->stream = TRUE;
+	dev->buf = buf;
+	dev->half = size / 2;
+	dev->nxt = 0;
+	conf_desc(dev, desc, buf, dev->half);
+	conf_desc(dev, &dev->desc2, buf + dev->half, dev->half);
+	// Block interrupt after every half.
+	desc->BTCTRL.reg |= DMAC_BTCTRL_BLOCKACT_INT;
+	dev->desc2.BTCTRL.reg |= DMAC_BTCTRL_BLOCKACT_INT;
+	desc->DESCADDR.reg = (unsigned int) &dev->desc2;
+	dev->desc2.DESCADDR.reg = (unsigned int) desc;
+	start(dev);
+}
+
+/**
+ * pwmplay_stop
+ */
+void pwmplay_stop(pwmplay dev, unsigned int duty)
+{
+	tc_stop(&dev->tc);
+	dmac_channel_abort(dev->channel);
+	tc_set_cc1(&dev->tc, duty);
+	tc_trigger(&dev->tc);
+}
+
+/**
+ * start
+ */
+static void start(pwmplay dev)
+{
+	tc_stop(&dev->tc);
+	tc_set_oneshot(&dev->tc, FALSE);
+	tc_set_cnt(&dev->tc, 0);
+	enable_dmac_transfer(dev->channel);
+	// First value is loaded by software trigger, next ones on overflow.
+	dmac_sw_trigger(dev->channel);
+	tc_trigger(&dev->tc);
+}
+
+/**
+ * conf_desc
+ */
+static void conf_desc(pwmplay dev, DmacDescriptor *desc, const uint16_t *src, int size)
+{
+	desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = size;
+	desc->SRCADDR.reg = (unsigned int) (src + size);
+	desc->DSTADDR.reg = (unsigned int) &dev->tc.mmio->COUNT16.CC[1].reg;
+}
+
+/**
+ * dma_hndlr
+ */
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	pwmplay d = dev;
+	uint8_t er = (intr == DMAC_TCMPL_INTR) ? 0 : 1;
+
+	if (d->stream) {
+		if (er) {
+			disable_dmac_channel_intr(d->channel);
+			tc_stop(&d->tc);
+			d->err_cnt++;
+			// Wake consumer, stream has stopped.
+			return (d->refill(d, NULL, -EDMA));
+		}
+		clear_dmac_channel_intr(d->channel);
+		d->blk_cnt++;
+		tsk_wkn = d->refill(d, d->buf + d->nxt * d->half, d->half);
+		d->nxt ^= 1;
+		return (tsk_wkn);
+	}
+	disable_dmac_channel_intr(d->channel);
+	if (er) {
+		xQueueSendFromISR(d->sig_que, &er, &tsk_wkn);
+		return (tsk_wkn);
+	}
+	// Last value has been loaded, let it last one period. Counter
+	// stops on next overflow which signals end of playback.
+	tc_clear_ovf_intr(&d->tc);
+	tc_set_oneshot(&d->tc, TRUE);
+	tc_enable_ovf_intr(&d->tc);
+	return (pdFALSE);
+}
+
+/**
+ * tc_isr_clbk
+ */
+static BaseType_t tc_isr_clbk(void *dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	pwmplay d = TC_OWNER(dev, struct pwmplay_dsc);
+	uint8_t er = 0;
+
+	tc_disable_ovf_intr(&d->tc);
+	tc_clear_ovf_intr(&d->tc);
+	xQueueSendFromISR(d->sig_que, &er, &tsk_wkn);
+	return (tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_pwmplay_stats
+ */
+void log_pwmplay_stats(pwmplay dev)
+{
+	msg(INF, "pwmplay.c: tc=%d top=%u blk=%u err=%u\n", dev->tc.id, dev->top, dev->blk_cnt,
+	    dev->err_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * pwmplay.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PWMPLAY_H
+#define PWMPLAY_H
+
+#ifndef PWMPLAY
+ #define PWMPLAY 0
+#endif
+
+#if PWMPLAY == 1
+
+#include "tc.h"
+#include "dmac.h"
+
+typedef struct pwmplay_dsc *pwmplay;
+
+struct pwmplay_dsc {
+	DmacDescriptor desc2 __attribute__((aligned(16))); // Second ping-pong descriptor (static instance).
+	int pwm_freq; // <SetIt> - PWM frequency [Hz] (one table value per period).
+	boolean_t inv; // <SetIt> - Invert WO[1] output.
+	void (*conf_pins)(enum tc_conf_pins_cmd); // <SetIt> - WO[1] pin configuration.
+	BaseType_t (*refill)(pwmplay dev, uint16_t *half, int size); // <SetIt> - NULL if not streaming (half NULL - error in size).
+	struct tc_timer_dsc tc; // <SetIt> - tc.id, tc.clk_gen, tc.clock_freq.
+	dmac_channel channel;
+	QueueHandle_t sig_que;
+	unsigned int top;
+	boolean_t stream;
+	uint16_t *buf;
+	int half;
+	int nxt;
+	unsigned int blk_cnt;
+	unsigned int err_cnt;
+};
+
+/**
+ * init_pwmplay
+ *
+ * Configure TC instance as 16-bit PWM (period in CC0, duty in CC1 driving
+ * WO[1]) and allocate DMAC channel which writes next CC1 value on every
+ * counter overflow.
+ *
+ * @dev: PWMPLAY instance.
+ */
+void init_pwmplay(pwmplay dev);
+
+/**
+ * pwmplay_top
+ *
+ * Returns: Compare value of 100 % duty cycle (table values are 0 - top).
+ */
+unsigned int pwmplay_top(pwmplay dev);
+
+/**
+ * pwmplay_play
+ *
+ * Play table of compare values, one value per PWM period. Caller task is
+ * blocked until table is played (loop FALSE), counter is stopped by one-shot
+ * mode on overflow ending period of last value. In loop mode table is repeated
+ * until pwmplay_stop() is called and function returns immediately.
+ *
+ * @dev: PWMPLAY instance.
+ * @tbl: Table of compare values (must be valid until playback ends).
+ * @size: Number of table items (1 - 65535).
+ * @loop: Repeat table.
+ *
+ * Returns: 0 - success; -EDMA - dma error.
+ */
+int pwmplay_play(pwmplay dev, const uint16_t *tbl, int size, boolean_t loop);
+
+/**
+ * pwmplay_stream
+ *
+ * Start endless playback of ping-pong buffer. When one half is played,
+ * dev->refill() is called from DMAC ISR with pointer to that half while
+ * the other half is playing. Buffer must be filled before call. On DMA
+ * error playback stops and dev->refill() is called with half NULL and
+ * size -EDMA.
+ *
+ * @dev: PWMPLAY instance.
+ * @buf: Buffer of compare values.
+ * @size: Number of buffer items (even, 2 - 65534).
+ */
+void pwmplay_stream(pwmplay dev, uint16_t *buf, int size);
+
+/**
+ * pwmplay_stop
+ *
+ * Stop playback and set output to duty.
+ *
+ * @dev: PWMPLAY instance.
+ * @duty: Compare value after stop.
+ */
+void pwmplay_stop(pwmplay dev, unsigned int duty);
+
+#if TERMOUT == 1
+/**
+ * log_pwmplay_stats
+ */
+void log_pwmplay_stats(pwmplay dev);
+#endif
+#endif
+
+#endif
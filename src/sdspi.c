@@ -0,0 +1,541 @@
+/*
+ * sdspi.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "dmac.h"
+#include "port.h"
+#include "spi.h"
+#include "spibus.h"
+#include "sdspi_sim.h"
+#include "sdspi.h"
+
+#if SDSPI == 1
+
+#define TOKEN_START_BLK   0xFE
+#define TOKEN_START_MULTI 0xFC
+#define TOKEN_STOP_TRAN   0xFD
+#define R1_IDLE           0x01
+#define R1_ILLEGAL_CMD    0x04
+#define ACMD41_HCS        0x40000000
+#define OCR_CCS           0x40
+
+static int init_seq(sdspi dev);
+static int send_cmd(sdspi dev, int cmd, unsigned int arg, uint8_t *r, int rsize);
+static int send_acmd(sdspi dev, int cmd, unsigned int arg);
+static int rcv_blk(sdspi dev, uint8_t *p);
+static int wait_rdy(sdspi dev);
+static int wait_token(sdspi dev, uint8_t *b);
+static void begin(sdspi dev);
+static void end(sdspi dev);
+static int xfer(sdspi dev, const void *tx, void *rx, int size);
+static uint8_t crc7(const uint8_t *p, int n);
+static uint16_t crc16(const uint8_t *p);
+
+/**
+ * init_sdspi
+ */
+void init_sdspi(sdspi dev)
+{
+#if SDSPI_SIM == 1
+	if (dev->sim == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+#else
+	if (dev->bdev == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->baudrate = dev->bdev->baudrate;
+#endif
+	if (NULL == (dev->mtx = xSemaphoreCreateMutex())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	dev->rdy = FALSE;
+	dev->wr_open = FALSE;
+}
+
+/**
+ * sdspi_card_init
+ */
+int sdspi_card_init(sdspi dev)
+{
+	int ret;
+
+	xSemaphoreTake(dev->mtx, portMAX_DELAY);
+	dev->rdy = FALSE;
+	dev->wr_open = FALSE;
+#if SDSPI_SIM == 1
+	sdspi_sim_xfer(dev->sim, NULL, NULL, 10);
+#else
+	spibus_set_baudrate(dev->bdev, SDSPI_INIT_BAUDRATE);
+	spibus_acquire(dev->bdev);
+	ret = spi_transfer(dev->bdev->bus->spi, NULL, NULL, 10);
+	spibus_release(dev->bdev);
+	if (ret) {
+		spibus_set_baudrate(dev->bdev, dev->baudrate);
+		xSemaphoreGive(dev->mtx);
+		return (ret);
+	}
+#endif
+	begin(dev);
+	ret = init_seq(dev);
+	end(dev);
+#if SDSPI_SIM != 1
+	spibus_set_baudrate(dev->bdev, dev->baudrate);
+#endif
+	if (!ret) {
+		dev->rdy = TRUE;
+	}
+	xSemaphoreGive(dev->mtx);
+	return (ret);
+}
+
+/**
+ * sdspi_read
+ */
+int sdspi_read(sdspi dev, unsigned int lba, void *buf, int nblk)
+{
+	int r, ret = 0;
+
+	if (nblk <= 0) {
+		return (-EADDR);
+	}
+	xSemaphoreTake(dev->mtx, portMAX_DELAY);
+	if (!dev->rdy || dev->wr_open) {
+		xSemaphoreGive(dev->mtx);
+		return (-ENRDY);
+	}
+	begin(dev);
+	r = send_cmd(dev, (nblk == 1) ? 17 : 18, (dev->sdhc) ? lba : lba * SDSPI_BLK_SIZE, NULL, 0);
+	if (r) {
+		ret = (r < 0) ? r : -ERCV;
+	} else {
+		for (int i = 0; i < nblk && !ret; i++) {
+			ret = rcv_blk(dev, (uint8_t *) buf + i * SDSPI_BLK_SIZE);
+		}
+		if (nblk > 1) {
+			r = send_cmd(dev, 12, 0, NULL, 0);
+			if (!ret && r) {
+				ret = (r < 0) ? r : -ERCV;
+			}
+		}
+	}
+	end(dev);
+	xSemaphoreGive(dev->mtx);
+	return (ret);
+}
+
+/**
+ * sdspi_write_start
+ */
+int sdspi_write_start(sdspi dev, unsigned int lba, int nblk)
+{
+	int r;
+
+	if (nblk <= 0) {
+		return (-EADDR);
+	}
+	xSemaphoreTake(dev->mtx, portMAX_DELAY);
+	if (!dev->rdy || dev->wr_open) {
+		xSemaphoreGive(dev->mtx);
+		return (-ENRDY);
+	}
+	begin(dev);
+	if (!(r = send_acmd(dev, 23, nblk))) {
+		r = send_cmd(dev, 25, (dev->sdhc) ? lba : lba * SDSPI_BLK_SIZE, NULL, 0);
+	}
+	end(dev);
+	if (!r) {
+		dev->wr_open = TRUE;
+	}
+	xSemaphoreGive(dev->mtx);
+	return ((r > 0) ? -ERCV : r);
+}
+
+/**
+ * sdspi_write_next
+ */
+int sdspi_write_next(sdspi dev, const void *buf)
+{
+	uint8_t b, c[2];
+	uint16_t crc;
+	int ret;
+
+	xSemaphoreTake(dev->mtx, portMAX_DELAY);
+	if (!dev->wr_open) {
+		xSemaphoreGive(dev->mtx);
+		return (-ENRDY);
+	}
+	crc = (dev->crc) ? crc16(buf) : 0xFFFF;
+	c[0] = crc >> 8;
+	c[1] = crc;
+	b = TOKEN_START_MULTI;
+	begin(dev);
+	if (!(ret = wait_rdy(dev)) && !(ret = xfer(dev, &b, NULL, 1)) &&
+	    !(ret = xfer(dev, buf, NULL, SDSPI_BLK_SIZE)) && !(ret = xfer(dev, c, NULL, 2)) &&
+	    !(ret = xfer(dev, NULL, &b, 1))) {
+		switch (b & 0x1F) {
+		case 0x05 :
+			dev->wr_blk_cnt++;
+			break;
+		case 0x0B :
+			dev->crc_err_cnt++;
+			ret = -EDATA;
+			break;
+		default   :
+			ret = -ESND;
+			break;
+		}
+	}
+	end(dev);
+	xSemaphoreGive(dev->mtx);
+	return (ret);
+}
+
+/**
+ * sdspi_write_stop
+ */
+int sdspi_write_stop(sdspi dev)
+{
+	uint8_t b = TOKEN_STOP_TRAN;
+	int ret;
+
+	xSemaphoreTake(dev->mtx, portMAX_DELAY);
+	if (!dev->wr_open) {
+		xSemaphoreGive(dev->mtx);
+		return (-ENRDY);
+	}
+	begin(dev);
+	if (!(ret = wait_rdy(dev)) && !(ret = xfer(dev, &b, NULL, 1)) &&
+	    !(ret = xfer(dev, NULL, NULL, 1))) {
+		ret = wait_rdy(dev);
+	}
+	end(dev);
+	dev->wr_open = FALSE;
+	xSemaphoreGive(dev->mtx);
+	return (ret);
+}
+
+/**
+ * sdspi_write
+ */
+int sdspi_write(sdspi dev, unsigned int lba, const void *buf, int nblk)
+{
+	int r, ret;
+
+	if ((ret = sdspi_write_start(dev, lba, nblk))) {
+		return (ret);
+	}
+	for (int i = 0; i < nblk && !ret; i++) {
+		ret = sdspi_write_next(dev, (const uint8_t *) buf + i * SDSPI_BLK_SIZE);
+	}
+	r = sdspi_write_stop(dev);
+	return ((ret) ? ret : r);
+}
+
+/**
+ * init_seq
+ */
+static int init_seq(sdspi dev)
+{
+	uint8_t r[4];
+	TickType_t t;
+	boolean_t v2;
+	int r1;
+
+	for (int i = 0; i < 10; i++) {
+		if ((r1 = send_cmd(dev, 0, 0, NULL, 0)) == R1_IDLE) {
+			break;
+		}
+	}
+	if (r1 != R1_IDLE) {
+		return ((r1 < 0) ? r1 : -EHW);
+	}
+	if ((r1 = send_cmd(dev, 8, 0x1AA, r, 4)) < 0) {
+		return (r1);
+	}
+	if (r1 == R1_IDLE && (r[2] & 0x0F) == 0x01 && r[3] == 0xAA) {
+		v2 = TRUE;
+	} else if (r1 & R1_ILLEGAL_CMD) {
+		v2 = FALSE;
+	} else {
+		return (-EHW);
+	}
+	t = xTaskGetTickCount();
+	while ((r1 = send_acmd(dev, 41, (v2) ? ACMD41_HCS : 0)) == R1_IDLE) {
+		if (xTaskGetTickCount() - t > SDSPI_INIT_TMO / portTICK_PERIOD_MS) {
+			return (-ETMO);
+		}
+		vTaskDelay(1);
+	}
+	if (r1) {
+		return ((r1 < 0) ? r1 : -EHW);
+	}
+	dev->sdhc = FALSE;
+	if (v2) {
+		if ((r1 = send_cmd(dev, 58, 0, r, 4))) {
+			return ((r1 < 0) ? r1 : -EHW);
+		}
+		dev->sdhc = (r[0] & OCR_CCS) ? TRUE : FALSE;
+	}
+	if (!dev->sdhc && (r1 = send_cmd(dev, 16, SDSPI_BLK_SIZE, NULL, 0))) {
+		return ((r1 < 0) ? r1 : -EHW);
+	}
+	if ((r1 = send_cmd(dev, 59, (dev->crc) ? 1 : 0, NULL, 0))) {
+		return ((r1 < 0) ? r1 : -EHW);
+	}
+	return (0);
+}
+
+/**
+ * send_cmd
+ *
+ * Send command frame and receive R1 (and rsize more response bytes).
+ *
+ * Returns: R1 (>= 0); -ERCV - no response; -ETMO - card busy;
+ *   -EDMA - dma error.
+ */
+static int send_cmd(sdspi dev, int cmd, unsigned int arg, uint8_t *r, int rsize)
+{
+	uint8_t f[6], b;
+	int ret;
+
+	if (cmd != 0 && (ret = wait_rdy(dev))) {
+		return (ret);
+	}
+	f[0] = 0x40 | cmd;
+	f[1] = arg >> 24;
+	f[2] = arg >> 16;
+	f[3] = arg >> 8;
+	f[4] = arg;
+	f[5] = crc7(f, 5);
+	if ((ret = xfer(dev, f, NULL, 6))) {
+		return (ret);
+	}
+	if (cmd == 12 && (ret = xfer(dev, NULL, &b, 1))) {
+		return (ret);
+	}
+	for (int i = 0; i < 10; i++) {
+		if ((ret = xfer(dev, NULL, &b, 1))) {
+			return (ret);
+		}
+		if (!(b & 0x80)) {
+			if (rsize && (ret = xfer(dev, NULL, r, rsize))) {
+				return (ret);
+			}
+			return (b);
+		}
+	}
+	return (-ERCV);
+}
+
+/**
+ * send_acmd
+ */
+static int send_acmd(sdspi dev, int cmd, unsigned int arg)
+{
+	int r1;
+
+	if ((r1 = send_cmd(dev, 55, 0, NULL, 0)) < 0) {
+		return (r1);
+	}
+	if (r1 & ~R1_IDLE) {
+		return (r1);
+	}
+	return (send_cmd(dev, cmd, arg, NULL, 0));
+}
+
+/**
+ * rcv_blk
+ */
+static int rcv_blk(sdspi dev, uint8_t *p)
+{
+	uint8_t b, c[2];
+	int ret;
+
+	if ((ret = wait_token(dev, &b))) {
+		return (ret);
+	}
+	if (b != TOKEN_START_BLK) {
+		return (-ERCV);
+	}
+	if ((ret = xfer(dev, NULL, p, SDSPI_BLK_SIZE)) || (ret = xfer(dev, NULL, c, 2))) {
+		return (ret);
+	}
+	if (dev->crc && crc16(p) != (c[0] << 8 | c[1])) {
+		dev->crc_err_cnt++;
+		return (-EDATA);
+	}
+	dev->rd_blk_cnt++;
+	return (0);
+}
+
+/**
+ * wait_rdy
+ *
+ * Wait for end of card busy state (DO held low).
+ */
+static int wait_rdy(sdspi dev)
+{
+	TickType_t t = xTaskGetTickCount();
+	uint8_t b;
+	int ret;
+
+	while (TRUE) {
+		if ((ret = xfer(dev, NULL, &b, 1))) {
+			return (ret);
+		}
+		if (b == 0xFF) {
+			return (0);
+		}
+		dev->busy_poll_cnt++;
+		if (xTaskGetTickCount() - t > SDSPI_BUSY_TMO / portTICK_PERIOD_MS) {
+			return (-ETMO);
+		}
+	}
+}
+
+/**
+ * wait_token
+ */
+static int wait_token(sdspi dev, uint8_t *b)
+{
+	TickType_t t = xTaskGetTickCount();
+	int ret;
+
+	while (TRUE) {
+		if ((ret = xfer(dev, NULL, b, 1))) {
+			return (ret);
+		}
+		if (*b != 0xFF) {
+			return (0);
+		}
+		if (xTaskGetTickCount() - t > SDSPI_BUSY_TMO / portTICK_PERIOD_MS) {
+			return (-ETMO);
+		}
+	}
+}
+
+/**
+ * begin
+ */
+static void begin(sdspi dev)
+{
+#if SDSPI_SIM == 1
+	sdspi_sim_cs(dev->sim, TRUE);
+#else
+	spibus_acquire(dev->bdev);
+	spibus_cs(dev->bdev, TRUE);
+#endif
+}
+
+/**
+ * end
+ */
+static void end(sdspi dev)
+{
+#if SDSPI_SIM == 1
+	sdspi_sim_cs(dev->sim, FALSE);
+	sdspi_sim_xfer(dev->sim, NULL, NULL, 1);
+#else
+	spibus_cs(dev->bdev, FALSE);
+	spi_transfer(dev->bdev->bus->spi, NULL, NULL, 1);
+	spibus_release(dev->bdev);
+#endif
+}
+
+/**
+ * xfer
+ */
+static int xfer(sdspi dev, const void *tx, void *rx, int size)
+{
+#if SDSPI_SIM == 1
+	sdspi_sim_xfer(dev->sim, tx, rx, size);
+	return (0);
+#else
+	return (spi_transfer(dev->bdev->bus->spi, tx, rx, size));
+#endif
+}
+
+/**
+ * crc7
+ */
+static uint8_t crc7(const uint8_t *p, int n)
+{
+	uint8_t crc = 0, b;
+
+	while (n--) {
+		b = *p++;
+		for (int i = 0; i < 8; i++) {
+			crc <<= 1;
+			if ((b ^ crc) & 0x80) {
+				crc ^= 0x09;
+			}
+			b <<= 1;
+		}
+	}
+	return (crc << 1 | 1);
+}
+
+/**
+ * crc16
+ */
+static uint16_t crc16(const uint8_t *p)
+{
+	uint16_t crc = 0;
+#if SDSPI_DMAC_CRC == 1
+	unsigned int c;
+
+	if (!crc_compute(p, SDSPI_BLK_SIZE, CRC16, &c)) {
+		return (c);
+	}
+	// DMA error, software calculation.
+#endif
+
+	for (int n = 0; n < SDSPI_BLK_SIZE; n++) {
+		crc ^= *p++ << 8;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return (crc);
+}
+
+#if TERMOUT == 1
+/**
+ * log_sdspi_stats
+ */
+void log_sdspi_stats(sdspi dev)
+{
+	msg(INF, "sdspi.c: rd_blk=%u wr_blk=%u crc_err=%u busy_poll=%u\n",
+	    dev->rd_blk_cnt, dev->wr_blk_cnt, dev->crc_err_cnt, dev->busy_poll_cnt);
+}
+#endif
+
+#endif
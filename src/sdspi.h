@@ -0,0 +1,167 @@
+/*
+ * sdspi.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SDSPI_H
+#define SDSPI_H
+
+#ifndef SDSPI
+ #define SDSPI 0
+#endif
+#ifndef SDSPI_DMAC_CRC
+ #define SDSPI_DMAC_CRC 0
+#endif
+#ifndef SDSPI_INIT_BAUDRATE
+ #define SDSPI_INIT_BAUDRATE 400000
+#endif
+#ifndef SDSPI_INIT_TMO
+ #define SDSPI_INIT_TMO 1000
+#endif
+#ifndef SDSPI_BUSY_TMO
+ #define SDSPI_BUSY_TMO 500
+#endif
+
+#if SDSPI == 1
+
+#include "spibus.h"
+#include "sdspi_sim.h"
+
+#define SDSPI_BLK_SIZE 512
+
+typedef struct sdspi_dsc *sdspi;
+
+struct sdspi_dsc {
+	spibus_dev bdev; // <SetIt> - Registered SPI bus device.
+#if SDSPI_SIM == 1
+	sdspi_sim sim; // <SetIt> - Simulated card (bdev is not used).
+#endif
+	boolean_t crc; // <SetIt> - Enable CRC protection of data blocks (CMD59).
+	SemaphoreHandle_t mtx;
+	boolean_t rdy;
+	boolean_t sdhc;
+	boolean_t wr_open;
+	int baudrate;
+	unsigned int rd_blk_cnt;
+	unsigned int wr_blk_cnt;
+	unsigned int crc_err_cnt;
+	unsigned int busy_poll_cnt;
+};
+
+/**
+ * init_sdspi
+ *
+ * Initialize SD card driver instance.
+ *
+ * @dev: SD card instance.
+ */
+void init_sdspi(sdspi dev);
+
+/**
+ * sdspi_card_init
+ *
+ * Initialize SD/SDHC card in SPI mode (CMD0, CMD8, ACMD41, CMD58).
+ * Initialization runs at SDSPI_INIT_BAUDRATE, then SCK is switched back
+ * to baudrate of bus device.
+ *
+ * @dev: SD card instance.
+ *
+ * Returns: 0 - success; -EHW - card not responding or not supported;
+ *   -ETMO - card initialization timeout; -EDMA - dma error.
+ */
+int sdspi_card_init(sdspi dev);
+
+/**
+ * sdspi_read
+ *
+ * Read blocks by CMD17 (one block) or CMD18 (multiple blocks). Block data
+ * are received by DMA.
+ *
+ * @dev: SD card instance.
+ * @lba: First block number.
+ * @buf: Destination buffer (nblk * SDSPI_BLK_SIZE bytes).
+ * @nblk: Number of blocks.
+ *
+ * Returns: 0 - success; -ENRDY - card not initialized or write open;
+ *   -ERCV - bad response; -EDATA - CRC error; -ETMO - timeout;
+ *   -EDMA - dma error.
+ */
+int sdspi_read(sdspi dev, unsigned int lba, void *buf, int nblk);
+
+/**
+ * sdspi_write_start
+ *
+ * Open multiple block write (ACMD23 pre-erase hint and CMD25).
+ *
+ * @dev: SD card instance.
+ * @lba: First block number.
+ * @nblk: Number of blocks which will be written.
+ *
+ * Returns: 0 - success; -ENRDY - card not initialized or write open;
+ *   -ERCV - bad response; -ETMO - timeout; -EDMA - dma error.
+ */
+int sdspi_write_start(sdspi dev, unsigned int lba, int nblk);
+
+/**
+ * sdspi_write_next
+ *
+ * Send next block of open write. Function waits for end of busy phase of
+ * previous block, sends data by DMA and returns without waiting for card
+ * programming, so the caller can fill the other buffer meanwhile.
+ *
+ * @dev: SD card instance.
+ * @buf: Block data (SDSPI_BLK_SIZE bytes).
+ *
+ * Returns: 0 - success; -ENRDY - write not open; -ESND - block rejected;
+ *   -EDATA - CRC error; -ETMO - timeout; -EDMA - dma error.
+ */
+int sdspi_write_next(sdspi dev, const void *buf);
+
+/**
+ * sdspi_write_stop
+ *
+ * Close multiple block write (stop token) and wait for end of programming.
+ *
+ * @dev: SD card instance.
+ *
+ * Returns: 0 - success; -ENRDY - write not open; -ETMO - timeout;
+ *   -EDMA - dma error.
+ */
+int sdspi_write_stop(sdspi dev);
+
+/**
+ * sdspi_write
+ *
+ * Write blocks (sdspi_write_start(), sdspi_write_next(), sdspi_write_stop()).
+ *
+ * @dev: SD card instance.
+ * @lba: First block number.
+ * @buf: Source buffer (nblk * SDSPI_BLK_SIZE bytes).
+ * @nblk: Number of blocks.
+ *
+ * Returns: See sdspi_write_start(), sdspi_write_next(), sdspi_write_stop().
+ */
+int sdspi_write(sdspi dev, unsigned int lba, const void *buf, int nblk);
+
+#if TERMOUT == 1
+/**
+ * log_sdspi_stats
+ */
+void log_sdspi_stats(sdspi dev);
+#endif
+#endif
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * sdspi_sim.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "sdspi_sim.h"
+
+#if SDSPI_SIM == 1
+
+#define BLK_SIZE 512
+
+static uint8_t out_byte(sdspi_sim sim);
+static void in_byte(sdspi_sim sim, uint8_t b);
+static void exec_cmd(sdspi_sim sim);
+static void resp(sdspi_sim sim, const uint8_t *p, int n);
+static uint16_t crc16(const uint8_t *p, int n);
+
+/**
+ * init_sdspi_sim
+ */
+void init_sdspi_sim(sdspi_sim sim)
+{
+	sim->state = SDSPI_SIM_STATE_CMD;
+	sim->cs = FALSE;
+	sim->idle = TRUE;
+	sim->app = FALSE;
+	sim->cmd_len = 0;
+	sim->resp_len = sim->resp_pos = 0;
+	sim->busy = 0;
+	sim->polls = 0;
+	sim->pre_erase = 0;
+	sim->rd_blk_cnt = 0;
+	sim->wr_blk_cnt = 0;
+}
+
+/**
+ * sdspi_sim_cs
+ */
+void sdspi_sim_cs(sdspi_sim sim, boolean_t act)
+{
+	sim->cs = act;
+	sim->cmd_len = 0;
+}
+
+/**
+ * sdspi_sim_xfer
+ */
+void sdspi_sim_xfer(sdspi_sim sim, const void *tx, void *rx, int size)
+{
+	uint8_t b;
+
+	for (int i = 0; i < size; i++) {
+		b = (sim->cs) ? out_byte(sim) : 0xFF;
+		if (sim->cs) {
+			in_byte(sim, (tx) ? ((const uint8_t *) tx)[i] : 0xFF);
+		}
+		if (rx) {
+			((uint8_t *) rx)[i] = b;
+		}
+	}
+}
+
+/**
+ * out_byte
+ */
+static uint8_t out_byte(sdspi_sim sim)
+{
+	uint8_t b;
+
+	if (sim->resp_pos < sim->resp_len) {
+		return (sim->resp[sim->resp_pos++]);
+	}
+	if (sim->busy) {
+		sim->busy--;
+		return (0x00);
+	}
+	if (sim->state != SDSPI_SIM_STATE_RD) {
+		return (0xFF);
+	}
+	if (sim->pos == 0) {
+		b = 0xFF;
+	} else if (sim->pos == 1) {
+		sim->crc = crc16(sim->mem + sim->lba * BLK_SIZE, BLK_SIZE);
+		b = 0xFE;
+	} else if (sim->pos < BLK_SIZE + 2) {
+		b = sim->mem[sim->lba * BLK_SIZE + sim->pos - 2];
+	} else if (sim->pos == BLK_SIZE + 2) {
+		b = sim->crc >> 8;
+	} else {
+		b = sim->crc;
+		sim->rd_blk_cnt++;
+		if (sim->multi && sim->lba + 1 < sim->blk_cnt) {
+			sim->lba++;
+			sim->pos = 0;
+			return (b);
+		}
+		sim->state = SDSPI_SIM_STATE_CMD;
+	}
+	sim->pos++;
+	return (b);
+}
+
+/**
+ * in_byte
+ */
+static void in_byte(sdspi_sim sim, uint8_t b)
+{
+	if (sim->state != SDSPI_SIM_STATE_WR) {
+		if (sim->cmd_len == 0 && (b & 0xC0) != 0x40) {
+			return;
+		}
+		sim->cmd[sim->cmd_len++] = b;
+		if (sim->cmd_len == 6) {
+			sim->cmd_len = 0;
+			exec_cmd(sim);
+		}
+		return;
+	}
+	if (sim->pos < 0) {
+		if (b == 0xFC || (b == 0xFE && !sim->multi)) {
+			sim->pos = 0;
+		} else if (b == 0xFD && sim->multi) {
+			sim->busy = sim->busy_bytes;
+			sim->state = SDSPI_SIM_STATE_CMD;
+		}
+		return;
+	}
+	if (sim->pos < BLK_SIZE) {
+		sim->mem[sim->lba * BLK_SIZE + sim->pos] = b;
+	}
+	if (++sim->pos == BLK_SIZE + 2) {
+		uint8_t r = 0x05;
+
+		resp(sim, &r, 1);
+		sim->busy = sim->busy_bytes;
+		sim->wr_blk_cnt++;
+		sim->pos = -1;
+		if (!sim->multi) {
+			sim->state = SDSPI_SIM_STATE_CMD;
+		} else if (++sim->lba == sim->blk_cnt) {
+			sim->lba--;
+		}
+	}
+}
+
+/**
+ * exec_cmd
+ */
+static void exec_cmd(sdspi_sim sim)
+{
+	uint8_t r[6];
+	unsigned int arg;
+	int cmd, lba;
+	boolean_t app = sim->app;
+
+	cmd = sim->cmd[0] & 0x3F;
+	arg = sim->cmd[1] << 24 | sim->cmd[2] << 16 | sim->cmd[3] << 8 | sim->cmd[4];
+	sim->app = FALSE;
+	r[0] = 0xFF;
+	r[1] = (sim->idle) ? 0x01 : 0x00;
+	if (app && cmd == 41) {
+		if (++sim->polls >= sim->init_polls) {
+			sim->idle = FALSE;
+		}
+		r[1] = (sim->idle) ? 0x01 : 0x00;
+		resp(sim, r, 2);
+		return;
+	}
+	if (app && cmd == 23) {
+		sim->pre_erase = arg & 0x7FFFFF;
+		resp(sim, r, 2);
+		return;
+	}
+	switch (cmd) {
+	case 0  :
+		sim->idle = TRUE;
+		sim->polls = 0;
+		sim->state = SDSPI_SIM_STATE_CMD;
+		r[1] = 0x01;
+		resp(sim, r, 2);
+		break;
+	case 8  :
+		r[2] = 0x00;
+		r[3] = 0x00;
+		r[4] = (arg >> 8) & 0x0F;
+		r[5] = arg;
+		resp(sim, r, 6);
+		break;
+	case 12 :
+		sim->state = SDSPI_SIM_STATE_CMD;
+		r[1] = 0xFF;
+		r[2] = (sim->idle) ? 0x01 : 0x00;
+		resp(sim, r, 3);
+		sim->busy = 2;
+		break;
+	case 16 :
+		if (arg != BLK_SIZE) {
+			r[1] |= 0x40;
+		}
+		resp(sim, r, 2);
+		break;
+	case 55 :
+		sim->app = TRUE;
+		resp(sim, r, 2);
+		break;
+	case 58 :
+		r[2] = (sim->sdhc) ? 0xC0 : 0x80;
+		r[3] = 0xFF;
+		r[4] = 0x80;
+		r[5] = 0x00;
+		resp(sim, r, 6);
+		break;
+	case 59 :
+		resp(sim, r, 2);
+		break;
+	case 17 :
+		/* FALLTHRU */
+	case 18 :
+		/* FALLTHRU */
+	case 24 :
+		/* FALLTHRU */
+	case 25 :
+		lba = (sim->sdhc) ? (int) arg : (int) (arg / BLK_SIZE);
+		if (sim->idle || lba < 0 || lba >= sim->blk_cnt) {
+			r[1] |= 0x20;
+			resp(sim, r, 2);
+			break;
+		}
+		sim->lba = lba;
+		sim->multi = (cmd == 18 || cmd == 25) ? TRUE : FALSE;
+		if (cmd == 17 || cmd == 18) {
+			sim->state = SDSPI_SIM_STATE_RD;
+			sim->pos = 0;
+		} else {
+			sim->state = SDSPI_SIM_STATE_WR;
+			sim->pos = -1;
+		}
+		resp(sim, r, 2);
+		break;
+	default :
+		r[1] |= 0x04;
+		resp(sim, r, 2);
+		break;
+	}
+}
+
+/**
+ * resp
+ */
+static void resp(sdspi_sim sim, const uint8_t *p, int n)
+{
+	for (int i = 0; i < n; i++) {
+		sim->resp[i] = p[i];
+	}
+	sim->resp_len = n;
+	sim->resp_pos = 0;
+}
+
+/**
+ * crc16
+ */
+static uint16_t crc16(const uint8_t *p, int n)
+{
+	uint16_t crc = 0;
+
+	while (n--) {
+		crc ^= *p++ << 8;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return (crc);
+}
+
+#endif
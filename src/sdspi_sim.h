@@ -0,0 +1,98 @@
+/*
+ * sdspi_sim.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SDSPI_SIM_H
+#define SDSPI_SIM_H
+
+#ifndef SDSPI_SIM
+ #define SDSPI_SIM 0
+#endif
+
+#if SDSPI_SIM == 1
+
+enum sdspi_sim_state {
+	SDSPI_SIM_STATE_CMD,
+	SDSPI_SIM_STATE_RD,
+	SDSPI_SIM_STATE_WR
+};
+
+typedef struct sdspi_sim_dsc *sdspi_sim;
+
+struct sdspi_sim_dsc {
+	uint8_t *mem; // <SetIt> - Card image (blk_cnt * 512 bytes).
+	int blk_cnt; // <SetIt>
+	boolean_t sdhc; // <SetIt>
+	int busy_bytes; // <SetIt> - Busy bytes after written block (programming time).
+	int init_polls; // <SetIt> - Number of ACMD41 polls before card leaves idle state.
+	enum sdspi_sim_state state;
+	boolean_t cs;
+	boolean_t idle;
+	boolean_t app;
+	boolean_t multi;
+	uint8_t cmd[6];
+	int cmd_len;
+	uint8_t resp[8];
+	int resp_len;
+	int resp_pos;
+	int busy;
+	int polls;
+	int lba;
+	int pos;
+	uint16_t crc;
+	unsigned int pre_erase;
+	unsigned int rd_blk_cnt;
+	unsigned int wr_blk_cnt;
+};
+
+/**
+ * init_sdspi_sim
+ *
+ * Initialize simulated SD card (SPI mode). Model has no dependency on
+ * hardware or RTOS and can be built on host. Driver built with
+ * SDSPI_SIM == 1 still uses FreeRTOS mutex and tick functions
+ * (xSemaphoreCreateMutex(), xSemaphoreTake(), xSemaphoreGive(),
+ * vTaskDelay(), xTaskGetTickCount()), host build must provide them.
+ *
+ * @sim: Simulated card instance.
+ */
+void init_sdspi_sim(sdspi_sim sim);
+
+/**
+ * sdspi_sim_cs
+ *
+ * Set chip select of simulated card.
+ *
+ * @sim: Simulated card instance.
+ * @act: TRUE - CS low (active), FALSE - CS high.
+ */
+void sdspi_sim_cs(sdspi_sim sim, boolean_t act);
+
+/**
+ * sdspi_sim_xfer
+ *
+ * Clock bytes through simulated card.
+ *
+ * @sim: Simulated card instance.
+ * @tx: Bytes sent to card (NULL - 0xFF).
+ * @rx: Bytes received from card (NULL - dropped).
+ * @size: Number of bytes.
+ */
+void sdspi_sim_xfer(sdspi_sim sim, const void *tx, void *rx, int size);
+#endif
+
+#endif
@@ -0,0 +1,231 @@
+/*
+ * sensched.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "tc.h"
+#include "dmac.h"
+#include "i2c.h"
+#include "sensched.h"
+#include <string.h>
+
+#if SENSCHED == 1
+
+static sensched_sens sens_list;
+static struct tc_timer_dsc tc;
+static void *i2c_dev;
+static uint32_t snap[2][(SENSCHED_SNAP_SIZE + 3) / 4];
+static uint32_t scratch[(SENSCHED_SNAP_SIZE + 3) / 4];
+static int snap_used;
+static volatile unsigned int seq;
+static unsigned int batch_cnt;
+static TaskHandle_t tsk_hndl;
+static const char *const tsk_nm = "SENSCHED";
+
+static void sensched_tsk(void *p);
+static BaseType_t isr_clbk(void *dev);
+static void run_batch(struct i2c_msg *msg, sensched_sens *s, int n, uint8_t *back);
+
+/**
+ * init_sensched
+ */
+void init_sensched(void *dev)
+{
+	unsigned int top;
+	int i;
+
+	if (0 > (i = tc_fit_prescaler(SENSCHED_GCLK_FREQ, SENSCHED_TICK, 1000, &top)) || top == 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	i2c_dev = dev;
+	if (pdPASS != xTaskCreate(sensched_tsk, tsk_nm, SENSCHED_TASK_STACK_SIZE, NULL,
+				  SENSCHED_TASK_PRIO, &tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	tc.id = SENSCHED_TC_ID;
+	tc.clk_gen = SENSCHED_GCLK_ID;
+	tc.clock_freq = SENSCHED_GCLK_FREQ;
+	tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	tc.prescaler = i;
+	tc.wavegen = TC_WAVEGEN_MFRQ;
+	tc.direction = TC_DIRECTION_UP;
+	tc.cc0 = top - 1;
+	tc.int_enable_mask = TC_INTENSET_OVF;
+	tc.isr_clbk = isr_clbk;
+	init_tc(&tc);
+}
+
+/**
+ * add_sensched_sens
+ */
+void add_sensched_sens(sensched_sens s)
+{
+	sensched_sens l;
+
+	if (s->rd_size <= 0 || s->period <= 0 ||
+	    snap_used + (int) sizeof(int) + s->rd_size > SENSCHED_SNAP_SIZE) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	s->ofs = snap_used;
+	snap_used = (snap_used + sizeof(int) + s->rd_size + 3) & ~3;
+	s->due = 1;
+	*(int *) ((uint8_t *) snap[0] + s->ofs) = -ENRDY;
+	*(int *) ((uint8_t *) snap[1] + s->ofs) = -ENRDY;
+	s->next = NULL;
+	taskENTER_CRITICAL();
+	if (sens_list) {
+		l = sens_list;
+		while (l->next) {
+			l = l->next;
+		}
+		l->next = s;
+	} else {
+		sens_list = s;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * sensched_read
+ */
+int sensched_read(sensched_sens s, void *buf)
+{
+	unsigned int q;
+	int err;
+
+	do {
+		q = seq;
+		barrier();
+		err = *(int *) ((uint8_t *) snap[q & 1] + s->ofs);
+		memcpy(buf, (uint8_t *) snap[q & 1] + s->ofs + sizeof(int), s->rd_size);
+		barrier();
+	} while (q != seq);
+	return (err);
+}
+
+/**
+ * sensched_seq
+ */
+unsigned int sensched_seq(void)
+{
+	return (seq);
+}
+
+/**
+ * sensched_tsk
+ */
+static void sensched_tsk(void *p)
+{
+	struct i2c_msg msg[SENSCHED_BATCH_MAX];
+	sensched_sens bs[SENSCHED_BATCH_MAX];
+	uint8_t *back;
+	sensched_sens s;
+	int ticks, n;
+	boolean_t upd;
+
+	while (TRUE) {
+		ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		back = (uint8_t *) snap[(seq & 1) ^ 1];
+		memcpy(back, snap[seq & 1], snap_used);
+		n = 0;
+		upd = FALSE;
+		for (s = sens_list; s; s = s->next) {
+			if ((s->due -= ticks) > 0) {
+				continue;
+			}
+			s->due = s->period;
+			msg[n].addr = s->addr;
+			msg[n].wr_buf = s->cmd;
+			msg[n].wr_size = s->cmd_size;
+			// Read to scratch, snapshot keeps previous data on error.
+			msg[n].rd_buf = (uint8_t *) scratch + s->ofs + sizeof(int);
+			msg[n].rd_size = s->rd_size;
+			bs[n++] = s;
+			if (n == SENSCHED_BATCH_MAX) {
+				run_batch(msg, bs, n, back);
+				n = 0;
+				upd = TRUE;
+			}
+		}
+		if (n) {
+			run_batch(msg, bs, n, back);
+			upd = TRUE;
+		}
+		if (upd) {
+			barrier();
+			seq++;
+		}
+	}
+}
+
+/**
+ * run_batch
+ */
+static void run_batch(struct i2c_msg *msg, sensched_sens *s, int n, uint8_t *back)
+{
+	i2c_transfer(i2c_dev, msg, n, SENSCHED_TICK / portTICK_PERIOD_MS + 1);
+	batch_cnt++;
+	for (int i = 0; i < n; i++) {
+		*(int *) (back + s[i]->ofs) = msg[i].err;
+		if (msg[i].err) {
+			s[i]->err_cnt++;
+		} else {
+			memcpy(back + s[i]->ofs + sizeof(int), msg[i].rd_buf, s[i]->rd_size);
+			s[i]->upd_cnt++;
+		}
+	}
+}
+
+/**
+ * isr_clbk
+ */
+static BaseType_t isr_clbk(void *dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+
+	tc_clear_ovf_intr((tc_timer) dev);
+	vTaskNotifyGiveFromISR(tsk_hndl, &tsk_wkn);
+	return (tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_sensched_stats
+ */
+void log_sensched_stats(void)
+{
+	msg(INF, "sensched.c: seq=%u batch=%u snap_used=%d\n", seq, batch_cnt, snap_used);
+	for (sensched_sens s = sens_list; s; s = s->next) {
+		msg(INF, "sensched.c: addr=0x%02X upd=%u err_cnt=%u err=%d\n",
+		    s->addr, s->upd_cnt, s->err_cnt, *(int *) ((uint8_t *) snap[seq & 1] + s->ofs));
+	}
+}
+#endif
+
+#endif
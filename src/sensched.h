@@ -0,0 +1,100 @@
+/*
+ * sensched.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SENSCHED_H
+#define SENSCHED_H
+
+#ifndef SENSCHED
+ #define SENSCHED 0
+#endif
+#ifndef SENSCHED_SNAP_SIZE
+ #define SENSCHED_SNAP_SIZE 128
+#endif
+#ifndef SENSCHED_BATCH_MAX
+ #define SENSCHED_BATCH_MAX 8
+#endif
+
+#if SENSCHED == 1
+
+typedef struct sensched_sens_dsc *sensched_sens;
+
+struct sensched_sens_dsc {
+	int addr; // <SetIt> - 7-bit I2C address.
+	const uint8_t *cmd; // <SetIt> - Bytes written before read (e.g. register address).
+	int cmd_size; // <SetIt> - 0 if no write phase.
+	int rd_size; // <SetIt>
+	int period; // <SetIt> - Read period in scheduler ticks.
+	int ofs;
+	int due;
+	unsigned int upd_cnt;
+	unsigned int err_cnt;
+	struct sensched_sens_dsc *next;
+};
+
+/**
+ * init_sensched
+ *
+ * Initialize sensor scheduler. Tick is generated by TC SENSCHED_TC_ID
+ * every SENSCHED_TICK ms.
+ *
+ * @dev: Initialized I2C master instance.
+ */
+void init_sensched(void *dev);
+
+/**
+ * add_sensched_sens
+ *
+ * Register sensor (space for read result and rd_size bytes of data is
+ * reserved in snapshot).
+ * Sensor is read at the next tick and then every period ticks.
+ *
+ * @s: Sensor instance.
+ */
+void add_sensched_sens(sensched_sens s);
+
+/**
+ * sensched_read
+ *
+ * Copy latest sensor data from published snapshot (lock-free, reader is
+ * retried only if snapshot was republished during copy).
+ *
+ * @s: Sensor instance.
+ * @buf: Destination buffer (rd_size bytes).
+ *
+ * Returns: Result of last read of sensor (0, -ENACK, -EHW, -EDMA, -ETMO,
+ *   -ENRDY - not read yet) taken from the same snapshot as data; data of
+ *   last successful read are copied.
+ */
+int sensched_read(sensched_sens s, void *buf);
+
+/**
+ * sensched_seq
+ *
+ * Returns: Number of published snapshots.
+ */
+unsigned int sensched_seq(void);
+
+#if TERMOUT == 1
+/**
+ * log_sensched_stats
+ */
+void log_sensched_stats(void);
+#endif
+#endif
+
+#endif
@@ -31,80 +31,84 @@
 #include "pm.h"
 #include "sercom.h"
 
-struct clbk {
+struct pers {
 	void *dev;
         BaseType_t (*hndlr)(void *);
+	void (*resume)(void *);
+	void (*suspend)(void *);
 };
 
-#ifdef SERCOM0
-static struct clbk clbk0;
+struct inst {
+	struct pers *volatile cur;
+	int pers_cnt;
+	struct pers pers[SERCOM_PERS_MAX];
+};
+
+static struct inst insts[SERCOM_INST_NUM];
 
+static struct inst *get_inst(int id);
+static struct pers *find_pers(struct inst *in, void *dev);
+static inline BaseType_t dispatch(struct inst *in);
+static void set_pers(struct inst *in, BaseType_t (*hndlr)(void *), void (*resume)(void *),
+                     void (*suspend)(void *), void *dev);
+
+#ifdef SERCOM0
 /**
  * SERCOM0_Handler
  */
 void SERCOM0_Handler(void)
 {
-	portEND_SWITCHING_ISR((*clbk0.hndlr)(clbk0.dev));
+	portEND_SWITCHING_ISR(dispatch(&insts[0]));
 }
 #endif
 
 #ifdef SERCOM1
-static struct clbk clbk1;
-
 /**
  * SERCOM1_Handler
  */
 void SERCOM1_Handler(void)
 {
-	portEND_SWITCHING_ISR((*clbk1.hndlr)(clbk1.dev));
+	portEND_SWITCHING_ISR(dispatch(&insts[1]));
 }
 #endif
 
 #ifdef SERCOM2
-static struct clbk clbk2;
-
 /**
  * SERCOM2_Handler
  */
 void SERCOM2_Handler(void)
 {
-	portEND_SWITCHING_ISR((*clbk2.hndlr)(clbk2.dev));
+	portEND_SWITCHING_ISR(dispatch(&insts[2]));
 }
 #endif
 
 #ifdef SERCOM3
-static struct clbk clbk3;
-
 /**
  * SERCOM3_Handler
  */
 void SERCOM3_Handler(void)
 {
-	portEND_SWITCHING_ISR((*clbk3.hndlr)(clbk3.dev));
+	portEND_SWITCHING_ISR(dispatch(&insts[3]));
 }
 #endif
 
 #ifdef SERCOM4
-static struct clbk clbk4;
-
 /**
  * SERCOM4_Handler
  */
 void SERCOM4_Handler(void)
 {
-	portEND_SWITCHING_ISR((*clbk4.hndlr)(clbk4.dev));
+	portEND_SWITCHING_ISR(dispatch(&insts[4]));
 }
 #endif
 
 #ifdef SERCOM5
-static struct clbk clbk5;
-
 /**
  * SERCOM5_Handler
  */
 void SERCOM5_Handler(void)
 {
-	portEND_SWITCHING_ISR((*clbk5.hndlr)(clbk5.dev));
+	portEND_SWITCHING_ISR(dispatch(&insts[5]));
 }
 #endif
 
@@ -113,47 +117,150 @@ void SERCOM5_Handler(void)
  */
 void reg_sercom_isr_clbk(int id, BaseType_t (*hndlr)(void *), void *dev)
 {
-#ifdef SERCOM0
-	if (id == ID_SERCOM0) {
-		clbk0.hndlr = hndlr;
-		clbk0.dev = dev;
+	set_pers(get_inst(id), hndlr, NULL, NULL, dev);
+}
+
+/**
+ * reg_sercom_pers
+ */
+void reg_sercom_pers(int id, BaseType_t (*hndlr)(void *), void (*resume)(void *),
+                     void (*suspend)(void *), void *dev)
+{
+	struct inst *in = get_inst(id);
+
+	if (in->cur != NULL && in->cur->dev != dev) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	set_pers(in, hndlr, resume, suspend, dev);
+}
+
+/**
+ * set_pers
+ */
+static void set_pers(struct inst *in, BaseType_t (*hndlr)(void *), void (*resume)(void *),
+                     void (*suspend)(void *), void *dev)
+{
+	struct pers *p;
+
+	if (NULL == (p = find_pers(in, dev))) {
+		if (in->pers_cnt == SERCOM_PERS_MAX) {
+			crit_err_exit(BAD_PARAMETER);
+		}
+		p = &in->pers[in->pers_cnt++];
+		p->dev = dev;
+	}
+	p->hndlr = hndlr;
+	p->resume = resume;
+	p->suspend = suspend;
+	in->cur = p;
+}
+
+/**
+ * sercom_release
+ */
+void sercom_release(int id)
+{
+	struct inst *in = get_inst(id);
+	struct pers *p;
+
+	if (NULL == (p = in->cur)) {
 		return;
 	}
-#endif
-#ifdef SERCOM1
-	if (id == ID_SERCOM1) {
-		clbk1.hndlr = hndlr;
-		clbk1.dev = dev;
+	if (p->suspend) {
+		(*p->suspend)(p->dev);
+	} else {
+		// No suspend hook, SERCOM stays enabled. Disable IRQ, handler
+		// is gone and interrupt flags would never be cleared.
+		NVIC_DisableIRQ((IRQn_Type) (SERCOM0_IRQn + (in - insts)));
+		NVIC_ClearPendingIRQ((IRQn_Type) (SERCOM0_IRQn + (in - insts)));
+	}
+	in->cur = NULL;
+}
+
+/**
+ * sercom_claim
+ */
+void sercom_claim(int id, void *dev)
+{
+	struct inst *in = get_inst(id);
+	struct pers *p;
+
+	if (NULL == (p = find_pers(in, dev)) || p->resume == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (in->cur == p) {
 		return;
 	}
+	sercom_release(id);
+	in->cur = p;
+	(*p->resume)(p->dev);
+}
+
+/**
+ * sercom_owner
+ */
+void *sercom_owner(int id)
+{
+	struct pers *p = get_inst(id)->cur;
+
+	return ((p) ? p->dev : NULL);
+}
+
+/**
+ * dispatch
+ */
+static inline BaseType_t dispatch(struct inst *in)
+{
+	struct pers *p = in->cur;
+
+	return ((p) ? (*p->hndlr)(p->dev) : pdFALSE);
+}
+
+/**
+ * get_inst
+ */
+static struct inst *get_inst(int id)
+{
+	switch (id) {
+#ifdef SERCOM0
+	case ID_SERCOM0 :
+		return (&insts[0]);
+#endif
+#ifdef SERCOM1
+	case ID_SERCOM1 :
+		return (&insts[1]);
 #endif
 #ifdef SERCOM2
-	if (id == ID_SERCOM2) {
-		clbk2.hndlr = hndlr;
-		clbk2.dev = dev;
-		return;
-	}
+	case ID_SERCOM2 :
+		return (&insts[2]);
 #endif
 #ifdef SERCOM3
-	if (id == ID_SERCOM3) {
-		clbk3.hndlr = hndlr;
-		clbk3.dev = dev;
-		return;
-	}
+	case ID_SERCOM3 :
+		return (&insts[3]);
 #endif
 #ifdef SERCOM4
-	if (id == ID_SERCOM4) {
-		clbk4.hndlr = hndlr;
-		clbk4.dev = dev;
-		return;
-	}
+	case ID_SERCOM4 :
+		return (&insts[4]);
 #endif
 #ifdef SERCOM5
-	if (id == ID_SERCOM5) {
-		clbk5.hndlr = hndlr;
-		clbk5.dev = dev;
-		return;
-	}
+	case ID_SERCOM5 :
+		return (&insts[5]);
 #endif
-	crit_err_exit(BAD_PARAMETER);
+	default         :
+		crit_err_exit(BAD_PARAMETER);
+		return (NULL);
+	}
+}
+
+/**
+ * find_pers
+ */
+static struct pers *find_pers(struct inst *in, void *dev)
+{
+	for (int i = 0; i < in->pers_cnt; i++) {
+		if (in->pers[i].dev == dev) {
+			return (&in->pers[i]);
+		}
+	}
+	return (NULL);
 }
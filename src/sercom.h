@@ -19,8 +19,70 @@
 #ifndef SERCOM_H
 #define SERCOM_H
 
+#ifndef SERCOM_PERS_MAX
+ #define SERCOM_PERS_MAX 2
+#endif
+
 /**
  * reg_sercom_isr_clbk
+ *
+ * Register ISR handler of driver without suspend/resume support and make it
+ * the owner of SERCOM. Replaces current owner unconditionally (previous
+ * personality is not suspended).
  */
 void reg_sercom_isr_clbk(int id, BaseType_t (*hndlr)(void *), void *dev);
+
+/**
+ * reg_sercom_pers
+ *
+ * Register SERCOM personality (driver instance) and make it the owner of
+ * SERCOM. Called from driver init function; SERCOM must be free or owned
+ * by the same driver instance. Up to SERCOM_PERS_MAX personalities can be
+ * registered per SERCOM instance.
+ *
+ * @id: SERCOM peripheral id.
+ * @hndlr: ISR handler.
+ * @resume: Restore clock, registers and pins of personality (enable_xxx()).
+ * @suspend: Disable personality (disable_xxx()).
+ * @dev: Driver instance.
+ */
+void reg_sercom_pers(int id, BaseType_t (*hndlr)(void *), void (*resume)(void *),
+                     void (*suspend)(void *), void *dev);
+
+/**
+ * sercom_release
+ *
+ * Suspend personality owning SERCOM and mark SERCOM free. If personality
+ * has no suspend function, SERCOM interrupt is disabled in NVIC (resume
+ * function of next owner must enable it).
+ *
+ * Caller must guarantee that owner is idle (no transaction and no DMAC
+ * transfer in progress), DMAC channels of owner are not stopped.
+ *
+ * @id: SERCOM peripheral id.
+ */
+void sercom_release(int id);
+
+/**
+ * sercom_claim
+ *
+ * Switch SERCOM to registered personality. Current owner is suspended,
+ * ISR handler is swapped by single pointer write and new personality
+ * is resumed from its saved register values. DMAC channels allocated
+ * during init are kept by each personality.
+ *
+ * Caller must guarantee that current owner is idle (no transaction and
+ * no DMAC transfer in progress), see sercom_release().
+ *
+ * @id: SERCOM peripheral id.
+ * @dev: Driver instance.
+ */
+void sercom_claim(int id, void *dev);
+
+/**
+ * sercom_owner
+ *
+ * Returns: Driver instance owning SERCOM; NULL - SERCOM free.
+ */
+void *sercom_owner(int id);
 #endif
@@ -0,0 +1,387 @@
+/*
+ * servo.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "port.h"
+#include "tc.h"
+#include "dmac.h"
+#include "servo.h"
+
+#if SERVO == 1
+
+static void build(servo dev, struct servo_tbl *tbl);
+static unsigned int place(servo dev, const unsigned int *t, int n, unsigned int s, unsigned int w);
+static void conf_desc(DmacDescriptor *desc, const void *src, volatile void *dst, int size, boolean_t word);
+static dmac_channel conf_chn(servo dev, enum dmac_chan_prio_level prio,
+                             BaseType_t (*hndlr)(void *, enum dmac_intr));
+static BaseType_t tgl_dma_hndlr(void *dev, enum dmac_intr intr);
+static BaseType_t nxt_dma_hndlr(void *dev, enum dmac_intr intr);
+static BaseType_t dma_hndlr(servo dev, dmac_channel chn, enum dmac_intr intr);
+static BaseType_t tc_isr_clbk(void *dev);
+
+/**
+ * init_servo
+ */
+void init_servo(servo dev)
+{
+	unsigned long long top;
+	unsigned int ticks;
+	int i;
+
+	if (!dev->frame_us) {
+		dev->frame_us = 20000;
+	}
+	if (!dev->min_us) {
+		dev->min_us = 500;
+	}
+	if (!dev->max_us) {
+		dev->max_us = 2500;
+	}
+	if (dev->chn_num < 1 || dev->chn_num > 32 || dev->min_us > dev->max_us) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (0 > (i = tc_fit_prescaler(dev->tc.clock_freq, dev->frame_us, 1000000, &ticks)) || ticks == 0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->tc.prescaler = i;
+	dev->tick_freq = tc_tick_freq(&dev->tc);
+	dev->top = ticks - 1;
+	dev->gap = (unsigned long long) dev->tick_freq * SERVO_GAP_US / 1000000 + 1;
+	dev->guard = (unsigned long long) dev->tick_freq * SERVO_GUARD_US / 1000000 + 1;
+	if ((unsigned long long) dev->tick_freq * dev->min_us / 1000000 < dev->gap) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	// Pulse starts are staggered so that all pulses end within frame. Each
+	// start can be delayed by place() up to 2 * gap per edge pair.
+	dev->start = dev->gap;
+	top = (unsigned long long) dev->tick_freq * dev->max_us / 1000000 + 2 * dev->gap +
+	      8ULL * dev->chn_num * dev->gap;
+	if (top >= dev->top) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->ofs = (dev->chn_num > 1) ? (dev->top - top) / (dev->chn_num - 1) : 0;
+	if (dev->chn_num > 1 && dev->ofs < dev->gap) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (NULL == (dev->sig_que = xQueueCreate(1, sizeof(uint8_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	if (NULL == (dev->width = pvPortMalloc(dev->chn_num * sizeof(uint16_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	for (int t = 0; t < 2; t++) {
+		if (NULL == (dev->tbl[t].tgl = pvPortMalloc(2 * dev->chn_num * sizeof(uint32_t))) ||
+		    NULL == (dev->tbl[t].nxt = pvPortMalloc(2 * dev->chn_num * sizeof(uint16_t)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	}
+	for (int j = 0; j < dev->chn_num; j++) {
+		dev->width[j] = 0;
+		dev->mask |= 1 << dev->pin[j];
+		conf_pin(dev->pin[j], dev->port, PIN_FUNC_OUTPUT_LOW, PIN_FEAT_END);
+	}
+	dev->tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	dev->tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	dev->tc.wavegen = TC_WAVEGEN_MPWM;
+	dev->tc.direction = TC_DIRECTION_UP;
+	dev->tc.cc0 = dev->top;
+	dev->tc.cc1 = dev->start;
+	dev->tc.cnt_rcont = TRUE;
+	dev->tc.int_enable_mask = TC_INTENSET_OVF;
+	dev->tc.isr_clbk = tc_isr_clbk;
+	init_tc(&dev->tc);
+	tc_stop(&dev->tc);
+	// Toggle channel has higher priority, pins switch first.
+	dev->tgl_chn = conf_chn(dev, DMAC_CHAN_PRIO_LEVEL3, tgl_dma_hndlr);
+	dev->nxt_chn = conf_chn(dev, DMAC_CHAN_PRIO_LEVEL2, nxt_dma_hndlr);
+	dev->act = 0;
+	build(dev, &dev->tbl[0]);
+	conf_desc(dev->tgl_chn->trans_desc, dev->tbl[0].tgl, &dev->port->OUTTGL.reg, dev->tbl[0].n, TRUE);
+	conf_desc(dev->nxt_chn->trans_desc, dev->tbl[0].nxt, &dev->tc.mmio->COUNT16.CC[1].reg, dev->tbl[0].n,
+	          FALSE);
+	enable_dmac_transfer(dev->tgl_chn);
+	enable_dmac_transfer(dev->nxt_chn);
+	tc_set_cnt(&dev->tc, 0);
+	tc_trigger(&dev->tc);
+}
+
+/**
+ * servo_set
+ */
+void servo_set(servo dev, int ch, int us)
+{
+	if (ch < 0 || ch >= dev->chn_num) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (us) {
+		if (us < dev->min_us) {
+			us = dev->min_us;
+		} else if (us > dev->max_us) {
+			us = dev->max_us;
+		}
+		dev->width[ch] = (unsigned long long) dev->tick_freq * us / 1000000;
+	} else {
+		dev->width[ch] = 0;
+	}
+}
+
+/**
+ * servo_update
+ */
+int servo_update(servo dev)
+{
+	DmacDescriptor *tgl[2] = {dev->tgl_chn->trans_desc, &dev->tgl_desc};
+	DmacDescriptor *nxt[2] = {dev->nxt_chn->trans_desc, &dev->nxt_desc};
+	struct servo_tbl *tbl;
+	unsigned int cnt, last;
+	int a = dev->act, b = dev->act ^ 1;
+	uint8_t sig;
+
+	if (dev->pend) {
+		xQueueReceive(dev->sig_que, &sig, portMAX_DELAY);
+	}
+	if (dev->fail) {
+		return (-EDMA);
+	}
+	tbl = &dev->tbl[b];
+	build(dev, tbl);
+	conf_desc(tgl[b], tbl->tgl, &dev->port->OUTTGL.reg, tbl->n, TRUE);
+	conf_desc(nxt[b], tbl->nxt, &dev->tc.mmio->COUNT16.CC[1].reg, tbl->n, FALSE);
+	// Running descriptors are fetched again after last edge of frame. Both
+	// links must be changed between two fetches (out of guard interval).
+	last = (dev->tbl[a].n > 1) ? dev->tbl[a].nxt[dev->tbl[a].n - 2] : dev->start;
+	while (pdTRUE == xQueueReceive(dev->sig_que, &sig, 0));
+	for (;;) {
+		taskENTER_CRITICAL();
+		if (dev->fail) {
+			taskEXIT_CRITICAL();
+			return (-EDMA);
+		}
+		cnt = tc_get_cnt(&dev->tc);
+		if (cnt + dev->guard < last || cnt > last + dev->guard) {
+			break;
+		}
+		taskEXIT_CRITICAL();
+	}
+	tgl[a]->DESCADDR.reg = (unsigned int) tgl[b];
+	nxt[a]->DESCADDR.reg = (unsigned int) nxt[b];
+	// Running table is used for up to two more frames.
+	dev->done_at = dev->frame + 3;
+	dev->pend = TRUE;
+	dev->act = b;
+	dev->upd_cnt++;
+	taskEXIT_CRITICAL();
+	return (0);
+}
+
+/**
+ * build
+ */
+static void build(servo dev, struct servo_tbl *tbl)
+{
+	unsigned int t[64], tt, s;
+	uint32_t m[64], mm;
+	int i, j, n = 0, k;
+
+	// First edge is start of channel 0 at fixed time, even if off.
+	t[n] = dev->start;
+	m[n++] = (dev->width[0]) ? 1 << dev->pin[0] : 0;
+	if (dev->width[0]) {
+		t[n] = dev->start + dev->width[0];
+		m[n++] = 1 << dev->pin[0];
+	}
+	for (i = 1; i < dev->chn_num; i++) {
+		if (!dev->width[i]) {
+			continue;
+		}
+		s = place(dev, t, n, dev->start + i * dev->ofs, dev->width[i]);
+		t[n] = s;
+		m[n++] = 1 << dev->pin[i];
+		t[n] = s + dev->width[i];
+		m[n++] = 1 << dev->pin[i];
+	}
+	// Insertion sort by time, first edge stays first.
+	for (i = 2; i < n; i++) {
+		tt = t[i];
+		mm = m[i];
+		for (j = i; j > 1 && t[j - 1] > tt; j--) {
+			t[j] = t[j - 1];
+			m[j] = m[j - 1];
+		}
+		t[j] = tt;
+		m[j] = mm;
+	}
+	// Only coincident edges are merged, other ones are gap apart.
+	for (i = 1, k = 0; i < n; i++) {
+		if (t[i] == t[k]) {
+			m[k] ^= m[i];
+		} else {
+			k++;
+			t[k] = t[i];
+			m[k] = m[i];
+		}
+	}
+	tbl->n = k + 1;
+	for (i = 0; i < tbl->n; i++) {
+		tbl->tgl[i] = m[i];
+		// Edge i writes time of edge i + 1, last one the first edge of next frame.
+		tbl->nxt[i] = (i + 1 < tbl->n) ? t[i + 1] : dev->start;
+	}
+}
+
+/**
+ * place
+ *
+ * Delay pulse start s so that both edges of pulse of width w coincide with
+ * or are at least gap apart from n edges already in table t. Pulse width
+ * is kept exact, only its phase in frame moves.
+ */
+static unsigned int place(servo dev, const unsigned int *t, int n, unsigned int s, unsigned int w)
+{
+	unsigned int e;
+	int j = 0, k;
+
+	while (j < n) {
+		for (k = 0; k < 2; k++) {
+			e = (k) ? s + w : s;
+			if (e < t[j] && t[j] - e < dev->gap) {
+				s += t[j] - e;
+				break;
+			}
+			if (e > t[j] && e - t[j] < dev->gap) {
+				s += t[j] + dev->gap - e;
+				break;
+			}
+		}
+		// Start delayed, check all edges again.
+		j = (k < 2) ? 0 : j + 1;
+	}
+	return (s);
+}
+
+/**
+ * conf_desc
+ */
+static void conf_desc(DmacDescriptor *desc, const void *src, volatile void *dst, int size, boolean_t word)
+{
+	desc->BTCTRL.reg = ((word) ? DMAC_BTCTRL_BEATSIZE_WORD : DMAC_BTCTRL_BEATSIZE_HWORD) |
+	                   DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = size;
+	desc->SRCADDR.reg = (unsigned int) src + size * ((word) ? sizeof(uint32_t) : sizeof(uint16_t));
+	desc->DSTADDR.reg = (unsigned int) dst;
+	desc->DESCADDR.reg = (unsigned int) desc;
+}
+
+/**
+ * conf_chn
+ */
+static dmac_channel conf_chn(servo dev, enum dmac_chan_prio_level prio,
+                             BaseType_t (*hndlr)(void *, enum dmac_intr))
+{
+	dmac_channel chn;
+
+	if (NULL == (chn = alloc_dmac_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	chn->dev = dev;
+	chn->hndlr = hndlr;
+	chn->trg_action = DMAC_TRG_ACTION_BEAT;
+	chn->trg_source = tc_dmac_trg_num(&dev->tc, TC_DMAC_TRG_MC1);
+	chn->prio_level = prio;
+	return (chn);
+}
+
+/**
+ * tgl_dma_hndlr
+ */
+static BaseType_t tgl_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	return (dma_hndlr(dev, ((servo) dev)->tgl_chn, intr));
+}
+
+/**
+ * nxt_dma_hndlr
+ */
+static BaseType_t nxt_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	return (dma_hndlr(dev, ((servo) dev)->nxt_chn, intr));
+}
+
+/**
+ * dma_hndlr
+ */
+static BaseType_t dma_hndlr(servo dev, dmac_channel chn, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	uint8_t sig = 1;
+
+	// Tables are looped without block interrupt, only error is signaled.
+	disable_dmac_channel_intr(chn);
+	if (intr == DMAC_TCMPL_INTR || dev->fail) {
+		return (pdFALSE);
+	}
+	// Edge table is out of step, stop pulses with outputs low.
+	tc_stop(&dev->tc);
+	dmac_channel_abort_isr(dev->tgl_chn);
+	dmac_channel_abort_isr(dev->nxt_chn);
+	dev->port->OUTCLR.reg = dev->mask;
+	dev->fail = TRUE;
+	dev->err_cnt++;
+	dev->pend = FALSE;
+	xQueueSendFromISR(dev->sig_que, &sig, &tsk_wkn);
+	return (tsk_wkn);
+}
+
+/**
+ * tc_isr_clbk
+ */
+static BaseType_t tc_isr_clbk(void *dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	servo d = TC_OWNER(dev, struct servo_dsc);
+	uint8_t sig = 0;
+
+	tc_clear_ovf_intr(&d->tc);
+	if (++d->frame == d->done_at && d->pend) {
+		d->pend = FALSE;
+		xQueueSendFromISR(d->sig_que, &sig, &tsk_wkn);
+	}
+	return (tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_servo_stats
+ */
+void log_servo_stats(servo dev)
+{
+	msg(INF, "servo.c: tc=%d tick=%u top=%u ofs=%u edges=%d upd=%u err=%u\n", dev->tc.id, dev->tick_freq,
+	    dev->top + 1, dev->ofs, dev->tbl[dev->act].n, dev->upd_cnt, dev->err_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * servo.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SERVO_H
+#define SERVO_H
+
+#ifndef SERVO
+ #define SERVO 0
+#endif
+
+#if SERVO == 1
+
+#ifndef SERVO_GAP_US
+ #define SERVO_GAP_US 2
+#endif
+
+#ifndef SERVO_GUARD_US
+ #define SERVO_GUARD_US 20
+#endif
+
+#include "tc.h"
+#include "dmac.h"
+
+struct servo_tbl {
+	int n;
+	uint32_t *tgl;
+	uint16_t *nxt;
+};
+
+typedef struct servo_dsc *servo;
+
+struct servo_dsc {
+	DmacDescriptor tgl_desc __attribute__((aligned(16))); // Second table descriptors (static instances).
+	DmacDescriptor nxt_desc __attribute__((aligned(16)));
+	struct tc_timer_dsc tc; // <SetIt> - tc.id, tc.clk_gen, tc.clock_freq.
+	PortGroup *port; // <SetIt> - PORT group of all servo pins.
+	const uint8_t *pin; // <SetIt> - Servo pins.
+	int chn_num; // <SetIt>
+	int frame_us; // <SetIt> - Frame length [us] (0 - 20000).
+	int min_us; // <SetIt> - Minimal pulse width [us] (0 - 500).
+	int max_us; // <SetIt> - Maximal pulse width [us] (0 - 2500).
+	dmac_channel tgl_chn;
+	dmac_channel nxt_chn;
+	QueueHandle_t sig_que;
+	unsigned int tick_freq;
+	unsigned int top;
+	unsigned int gap;
+	unsigned int guard;
+	unsigned int start;
+	unsigned int ofs;
+	uint16_t *width;
+	uint32_t mask;
+	boolean_t fail;
+	struct servo_tbl tbl[2];
+	int act;
+	unsigned int frame;
+	unsigned int done_at;
+	boolean_t pend;
+	unsigned int upd_cnt;
+	unsigned int err_cnt;
+};
+
+/**
+ * init_servo
+ *
+ * Configure TC instance as frame counter (frame in CC0) and two DMAC
+ * channels triggered by CC1 match. First channel writes toggle mask of
+ * pins switching at that time into PORT OUTTGL, second one writes time of
+ * next edge into CC1. Both channels loop over the frame edge table, so
+ * pulses are generated without CPU and their timing does not depend on
+ * system load. Pulse of channel i starts at time staggered within frame,
+ * start is delayed if its edges would be closer than SERVO_GAP_US to edges
+ * of other channels (pulse widths are exact). All pulses are off after
+ * initialization. DMA error stops pulses with outputs low.
+ *
+ * @dev: Servo instance.
+ */
+void init_servo(servo dev);
+
+/**
+ * servo_set
+ *
+ * Set channel pulse width. New width is used by next servo_update().
+ *
+ * @dev: Servo instance.
+ * @ch: Channel index.
+ * @us: Pulse width [us] (limited to min_us - max_us); 0 - pulses off.
+ */
+void servo_set(servo dev, int ch, int us);
+
+/**
+ * servo_update
+ *
+ * Build edge table from channel widths and link it after the running one.
+ * DMAC switches tables at frame boundary, new widths are output within
+ * three frames. Caller task is blocked until switch of previous update is
+ * finished.
+ *
+ * @dev: Servo instance.
+ *
+ * Returns: 0 - success; -EDMA - dma error, pulses are stopped.
+ */
+int servo_update(servo dev);
+
+#if TERMOUT == 1
+/**
+ * log_servo_stats
+ */
+void log_servo_stats(servo dev);
+#endif
+#endif
+
+#endif
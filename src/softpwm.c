@@ -0,0 +1,263 @@
+/*
+ * softpwm.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "port.h"
+#include "tc.h"
+#include "softpwm.h"
+
+#if SOFTPWM == 1
+
+#define GRP(port) ((port) - &PORT->Group[0])
+
+
+static void build(softpwm dev, struct softpwm_tbl *tbl);
+static inline void apply(const uint32_t *set, const uint32_t *clr);
+static BaseType_t tc_isr_clbk(void *dev);
+
+/**
+ * init_softpwm
+ */
+void init_softpwm(softpwm dev)
+{
+	unsigned int top;
+	int i;
+
+	if (dev->chn_num < 1 || dev->chn_num > 256 ||
+	    0 > (i = tc_fit_prescaler(dev->tc.clock_freq, 1, dev->pwm_freq, &top)) || top < 2) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->top = top - 1;
+	dev->tc.prescaler = i;
+	dev->margin = (unsigned long long) tc_tick_freq(&dev->tc) * SOFTPWM_MARGIN_US / 1000000;
+	if (!dev->margin) {
+		dev->margin = 1;
+	}
+	if (NULL == (dev->duty = pvPortMalloc(dev->chn_num * sizeof(unsigned short))) ||
+	    NULL == (dev->ord = pvPortMalloc(dev->chn_num)) ||
+	    NULL == (dev->tbl[0].edge = pvPortMalloc(dev->chn_num * sizeof(struct softpwm_edge))) ||
+	    NULL == (dev->tbl[1].edge = pvPortMalloc(dev->chn_num * sizeof(struct softpwm_edge)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	for (int j = 0; j < dev->chn_num; j++) {
+		dev->duty[j] = 0;
+		conf_pin(dev->chn[j].pin, dev->chn[j].port,
+		         (dev->chn[j].inv) ? PIN_FUNC_OUTPUT_HIGH : PIN_FUNC_OUTPUT_LOW, PIN_FEAT_END);
+	}
+	build(dev, &dev->tbl[0]);
+	dev->act = &dev->tbl[0];
+	dev->idx = 0;
+	dev->tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	dev->tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	dev->tc.wavegen = TC_WAVEGEN_MPWM;
+	dev->tc.direction = TC_DIRECTION_UP;
+	dev->tc.cc0 = dev->top;
+	dev->tc.cc1 = dev->top;
+	dev->tc.cnt_rcont = TRUE;
+	dev->tc.int_enable_mask = TC_INTENSET_OVF;
+	dev->tc.isr_clbk = tc_isr_clbk;
+	init_tc(&dev->tc);
+}
+
+/**
+ * softpwm_top
+ */
+unsigned int softpwm_top(softpwm dev)
+{
+	return (dev->top + 1);
+}
+
+/**
+ * softpwm_set
+ */
+void softpwm_set(softpwm dev, int ch, unsigned int duty)
+{
+	if (ch < 0 || ch >= dev->chn_num) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->duty[ch] = (duty + dev->margin > dev->top) ? dev->top + 1 : duty;
+}
+
+/**
+ * softpwm_update
+ */
+void softpwm_update(softpwm dev)
+{
+	struct softpwm_tbl *tbl;
+
+	// Inactive table is not accessed by ISR while no switch is pending.
+	taskENTER_CRITICAL();
+	dev->pend = FALSE;
+	tbl = (dev->act == &dev->tbl[0]) ? &dev->tbl[1] : &dev->tbl[0];
+	taskEXIT_CRITICAL();
+	build(dev, tbl);
+	barrier();
+	dev->pend = TRUE;
+}
+
+/**
+ * softpwm_pending
+ */
+boolean_t softpwm_pending(softpwm dev)
+{
+	return (dev->pend);
+}
+
+/**
+ * build
+ */
+static void build(softpwm dev, struct softpwm_tbl *tbl)
+{
+	struct softpwm_edge *e = NULL;
+	int i, j, g, n = 0;
+	unsigned char c;
+	uint32_t m;
+
+	for (g = 0; g < PORT_GROUPS; g++) {
+		tbl->set[g] = 0;
+		tbl->clr[g] = 0;
+	}
+	// Insertion sort of channel indexes by duty.
+	for (i = 0; i < dev->chn_num; i++) {
+		c = i;
+		for (j = i; j > 0 && dev->duty[dev->ord[j - 1]] > dev->duty[c]; j--) {
+			dev->ord[j] = dev->ord[j - 1];
+		}
+		dev->ord[j] = c;
+	}
+	for (i = 0; i < dev->chn_num; i++) {
+		c = dev->ord[i];
+		g = GRP(dev->chn[c].port);
+		m = 1 << dev->chn[c].pin;
+		// Active phase starts at overflow.
+		if (dev->duty[c] == 0) {
+			if (dev->chn[c].inv) {
+				tbl->set[g] |= m;
+			} else {
+				tbl->clr[g] |= m;
+			}
+			continue;
+		}
+		if (dev->chn[c].inv) {
+			tbl->clr[g] |= m;
+		} else {
+			tbl->set[g] |= m;
+		}
+		if (dev->duty[c] > dev->top) {
+			continue;
+		}
+		if (!e || e->t != dev->duty[c]) {
+			e = &tbl->edge[n++];
+			e->t = dev->duty[c];
+			for (j = 0; j < PORT_GROUPS; j++) {
+				e->set[j] = 0;
+				e->clr[j] = 0;
+			}
+		}
+		if (dev->chn[c].inv) {
+			e->set[g] |= m;
+		} else {
+			e->clr[g] |= m;
+		}
+	}
+	tbl->n = n;
+	if ((unsigned int) n > dev->max_edges) {
+		dev->max_edges = n;
+	}
+}
+
+/**
+ * apply
+ */
+static inline void apply(const uint32_t *set, const uint32_t *clr)
+{
+	for (int g = 0; g < PORT_GROUPS; g++) {
+		if (set[g]) {
+			PORT->Group[g].OUTSET.reg = set[g];
+		}
+		if (clr[g]) {
+			PORT->Group[g].OUTCLR.reg = clr[g];
+		}
+	}
+}
+
+/**
+ * tc_isr_clbk
+ */
+static BaseType_t tc_isr_clbk(void *dev)
+{
+	softpwm d = TC_OWNER(dev, struct softpwm_dsc);
+	uint8_t flg = d->tc.mmio->COUNT16.INTFLAG.reg;
+	struct softpwm_edge *e;
+	unsigned int cnt;
+
+	if (flg & TC_INTFLAG_OVF) {
+		tc_clear_ovf_intr(&d->tc);
+		if (d->pend) {
+			d->act = (d->act == &d->tbl[0]) ? &d->tbl[1] : &d->tbl[0];
+			d->pend = FALSE;
+			d->upd_cnt++;
+		}
+		apply(d->act->set, d->act->clr);
+		d->idx = 0;
+		if (d->act->n) {
+			tc_clear_mc1_intr(&d->tc);
+			tc_enable_mc1_intr(&d->tc);
+		}
+	} else {
+		tc_clear_mc1_intr(&d->tc);
+	}
+	// All edges due within margin are applied in this pass, CC1 is set
+	// for the first later one.
+	while (d->idx < d->act->n) {
+		e = &d->act->edge[d->idx];
+		cnt = tc_get_cnt(&d->tc);
+		if (e->t > cnt + d->margin) {
+			tc_post_cc1(&d->tc, e->t);
+			return (pdFALSE);
+		}
+		if (cnt > e->t + d->margin) {
+			d->late_cnt++;
+		}
+		apply(e->set, e->clr);
+		d->idx++;
+	}
+	tc_disable_mc1_intr(&d->tc);
+	return (pdFALSE);
+}
+
+#if TERMOUT == 1
+/**
+ * log_softpwm_stats
+ */
+void log_softpwm_stats(softpwm dev)
+{
+	msg(INF, "softpwm.c: tc=%d top=%u chn=%d max_edges=%u upd=%u late=%u\n", dev->tc.id, dev->top + 1,
+	    dev->chn_num, dev->max_edges, dev->upd_cnt, dev->late_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * softpwm.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SOFTPWM_H
+#define SOFTPWM_H
+
+#ifndef SOFTPWM
+ #define SOFTPWM 0
+#endif
+
+#if SOFTPWM == 1
+
+#ifndef SOFTPWM_MARGIN_US
+ #define SOFTPWM_MARGIN_US 4
+#endif
+
+#include "tc.h"
+
+struct softpwm_chn {
+	PortGroup *port;
+	int pin;
+	boolean_t inv; // Output LOW in active phase.
+};
+
+struct softpwm_edge {
+	unsigned int t;
+	uint32_t set[PORT_GROUPS];
+	uint32_t clr[PORT_GROUPS];
+};
+
+struct softpwm_tbl {
+	int n;
+	uint32_t set[PORT_GROUPS];
+	uint32_t clr[PORT_GROUPS];
+	struct softpwm_edge *edge;
+};
+
+typedef struct softpwm_dsc *softpwm;
+
+struct softpwm_dsc {
+	struct tc_timer_dsc tc; // <SetIt> - tc.id, tc.clk_gen, tc.clock_freq.
+	int pwm_freq; // <SetIt> - PWM frequency [Hz].
+	struct softpwm_chn *chn; // <SetIt> - Channel pins.
+	int chn_num; // <SetIt>
+	unsigned int top;
+	unsigned int margin;
+	unsigned short *duty;
+	unsigned char *ord;
+	struct softpwm_tbl tbl[2];
+	struct softpwm_tbl *act;
+	int idx;
+	volatile boolean_t pend;
+	unsigned int upd_cnt;
+	unsigned int late_cnt;
+	unsigned int max_edges;
+};
+
+/**
+ * init_softpwm
+ *
+ * Configure channel pins as outputs (inactive level) and TC instance as
+ * period counter (period in CC0). Overflow starts active phase of all
+ * channels, CC1 is programmed for next distinct edge time from sorted
+ * table. Pins switching together are updated by one OUTSET/OUTCLR write
+ * per PORT group.
+ *
+ * @dev: SOFTPWM instance.
+ */
+void init_softpwm(softpwm dev);
+
+/**
+ * softpwm_top
+ *
+ * Returns: Duty of 100 % (duty values are 0 - top).
+ */
+unsigned int softpwm_top(softpwm dev);
+
+/**
+ * softpwm_set
+ *
+ * Set channel duty. New duty is used by next softpwm_update().
+ *
+ * @dev: SOFTPWM instance.
+ * @ch: Channel index.
+ * @duty: Active phase length (0 - top). Duty ending closer than
+ *        SOFTPWM_MARGIN_US to period end is rounded to 100 %.
+ */
+void softpwm_set(softpwm dev, int ch, unsigned int duty);
+
+/**
+ * softpwm_update
+ *
+ * Build sorted edge table from channel duties. Table is switched by TC ISR
+ * at next period boundary, so all channels change in the same period. Not
+ * yet switched table from previous call is replaced.
+ *
+ * @dev: SOFTPWM instance.
+ */
+void softpwm_update(softpwm dev);
+
+/**
+ * softpwm_pending
+ *
+ * Returns: TRUE - table from last update is not switched yet.
+ */
+boolean_t softpwm_pending(softpwm dev);
+
+#if TERMOUT == 1
+/**
+ * log_softpwm_stats
+ */
+void log_softpwm_stats(softpwm dev);
+#endif
+#endif
+
+#endif
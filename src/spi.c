@@ -0,0 +1,713 @@
+/*
+ * spi.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "sercom.h"
+#include "dmac.h"
+#include "spi.h"
+
+#if SPI_SLAVE == 1
+struct slv_msg {
+	int buf;
+	int size;
+	boolean_t err;
+};
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+static BaseType_t spi_hndlr(void *dev);
+#endif
+#if SPI_MASTER == 1
+static inline void put_char(spi dev);
+static uint8_t baud_reg(spi dev);
+#endif
+#if DMAC_ON_CHIP == 1 && SPI_MASTER == 1
+static int dma_transfer(spi dev, const void *tx, void *rx, int size);
+#endif
+#if DMAC_ON_CHIP == 1 && (SPI_MASTER == 1 || SPI_SLAVE == 1)
+static BaseType_t rx_dma_hndlr(void *dev, enum dmac_intr intr);
+static BaseType_t tx_dma_hndlr(void *dev, enum dmac_intr intr);
+#endif
+#if SPI_SLAVE == 1
+static BaseType_t slv_hndlr(spi dev);
+static void slv_start(spi dev);
+static void slv_arm(spi dev, int buf);
+static void slv_flush(spi dev);
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * init_spi
+ */
+void init_spi(spi dev, enum spi_mode m)
+{
+	if (dev->sig_que == NULL) {
+		if (NULL == (dev->sig_que = xQueueCreate(1, sizeof(uint8_t)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+	} else {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->mode = m;
+	if (dev->bit_order == SPI_BIT_ORDER_LSB) {
+		dev->reg_ctrla |= SERCOM_SPI_CTRLA_DORD;
+	}
+	if (dev->clk_mode == SPI_CLK_MODE_1 || dev->clk_mode == SPI_CLK_MODE_3) {
+		dev->reg_ctrla |= SERCOM_SPI_CTRLA_CPHA;
+	}
+	if (dev->clk_mode == SPI_CLK_MODE_2 || dev->clk_mode == SPI_CLK_MODE_3) {
+		dev->reg_ctrla |= SERCOM_SPI_CTRLA_CPOL;
+	}
+	dev->reg_ctrla |= SERCOM_SPI_CTRLA_DIPO(dev->di_pad);
+	dev->reg_ctrla |= SERCOM_SPI_CTRLA_DOPO(dev->do_pad);
+        if (dev->standby == SPI_STANDBY_ACTIVE) {
+		dev->reg_ctrla |= SERCOM_SPI_CTRLA_RUNSTDBY;
+	}
+	switch (m) {
+#if SPI_MASTER == 1
+	case SPI_MASTER_MODE :
+		dev->reg_ctrla |= SERCOM_SPI_CTRLA_MODE_SPI_MASTER;
+		if (dev->hw_ss) {
+			dev->reg_ctrlb |= SERCOM_SPI_CTRLB_MSSEN;
+		}
+		dev->reg_ctrlb |= SERCOM_SPI_CTRLB_CHSIZE(dev->char_size) | SERCOM_SPI_CTRLB_RXEN;
+		dev->reg_baud = baud_reg(dev);
+		dev->dummy_tx = (dev->char_size == SPI_CHAR_SIZE_9_BITS) ? 0x01FF : 0xFF;
+		break;
+#endif
+#if SPI_SLAVE == 1
+	case SPI_SLAVE_MODE  :
+#if DMAC_ON_CHIP != 1
+		// Slave transactions are received by DMAC only.
+		crit_err_exit(BAD_PARAMETER);
+#endif
+		if (NULL == (dev->slv_que = xQueueCreate(2, sizeof(struct slv_msg)))) {
+			crit_err_exit(MALLOC_ERROR);
+		}
+		dev->reg_ctrla |= SERCOM_SPI_CTRLA_MODE_SPI_SLAVE;
+		if (dev->addr_mode != SPI_ADDR_MODE_OFF) {
+			dev->reg_ctrla |= SERCOM_SPI_CTRLA_FORM(2);
+			dev->reg_ctrlb |= SERCOM_SPI_CTRLB_AMODE(dev->addr_mode - 1);
+			dev->reg_addr = SERCOM_SPI_ADDR_ADDR(dev->addr) | SERCOM_SPI_ADDR_ADDRMASK(dev->addr_mask);
+		}
+		dev->reg_ctrlb |= SERCOM_SPI_CTRLB_PLOADEN | SERCOM_SPI_CTRLB_RXEN;
+		dev->char_size = SPI_CHAR_SIZE_8_BITS;
+		dev->dma = TRUE;
+		dev->slv_free = 0x03;
+		dev->slv_cur = -1;
+		break;
+#endif
+	default              :
+		crit_err_exit(BAD_PARAMETER);
+		break;
+	}
+	switch (dev->id) {
+#ifdef SERCOM0
+	case ID_SERCOM0 :
+		dev->mmio = (SercomSpi *) SERCOM0;
+		dev->irqn = SERCOM0_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+		dev->apb_mask = PM_APBCMASK_SERCOM0;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM0_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x01;
+                dev->dmac_tx_trg_num = 0x02;
+#endif
+		break;
+#endif
+#ifdef SERCOM1
+	case ID_SERCOM1 :
+		dev->mmio = (SercomSpi *) SERCOM1;
+		dev->irqn = SERCOM1_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM1;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM1_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x03;
+                dev->dmac_tx_trg_num = 0x04;
+#endif
+		break;
+#endif
+#ifdef SERCOM2
+	case ID_SERCOM2 :
+		dev->mmio = (SercomSpi *) SERCOM2;
+		dev->irqn = SERCOM2_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM2;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM2_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x05;
+                dev->dmac_tx_trg_num = 0x06;
+#endif
+		break;
+#endif
+#ifdef SERCOM3
+        case ID_SERCOM3 :
+		dev->mmio = (SercomSpi *) SERCOM3;
+		dev->irqn = SERCOM3_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM3;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM3_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x07;
+                dev->dmac_tx_trg_num = 0x08;
+#endif
+		break;
+#endif
+#ifdef SERCOM4
+	case ID_SERCOM4 :
+		dev->mmio = (SercomSpi *) SERCOM4;
+		dev->irqn = SERCOM4_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM4;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM4_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x09;
+                dev->dmac_tx_trg_num = 0x0A;
+#endif
+		break;
+#endif
+#ifdef SERCOM5
+        case ID_SERCOM5 :
+		dev->mmio = (SercomSpi *) SERCOM5;
+		dev->irqn = SERCOM5_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_SERCOM5;
+                dev->clk_chn = GCLK_CLKCTRL_ID_SERCOM5_CORE_Val;
+#if DMAC_ON_CHIP == 1
+		dev->dmac_rx_trg_num = 0x0B;
+                dev->dmac_tx_trg_num = 0x0C;
+#endif
+		break;
+#endif
+	default         :
+		crit_err_exit(BAD_PARAMETER);
+		break;
+	}
+#if DMAC_ON_CHIP == 1
+	if (dev->dma) {
+		if (NULL == (dev->rx_channel = alloc_dmac_channel())) {
+			crit_err_exit(UNEXP_PROG_STATE);
+		}
+		dev->rx_channel->dev = dev;
+		dev->rx_channel->hndlr = rx_dma_hndlr;
+		dev->rx_channel->trg_action = DMAC_TRG_ACTION_BEAT;
+                dev->rx_channel->trg_source = dev->dmac_rx_trg_num;
+                dev->rx_channel->prio_level = DMAC_CHAN_PRIO_LEVEL1;
+		if (NULL == (dev->tx_channel = alloc_dmac_channel())) {
+			crit_err_exit(UNEXP_PROG_STATE);
+		}
+		dev->tx_channel->dev = dev;
+		dev->tx_channel->hndlr = tx_dma_hndlr;
+		dev->tx_channel->trg_action = DMAC_TRG_ACTION_BEAT;
+                dev->tx_channel->trg_source = dev->dmac_tx_trg_num;
+                dev->tx_channel->prio_level = DMAC_CHAN_PRIO_LEVEL0;
+	}
+#endif
+	NVIC_DisableIRQ(dev->irqn);
+        enable_clk_channel(dev->clk_chn, dev->clk_gen);
+        enable_per_apb_clk(dev->apb_bus_ins, dev->apb_mask);
+	reg_sercom_pers(dev->id, spi_hndlr, enable_spi, disable_spi, dev);
+	dev->mmio->CTRLA.reg = SERCOM_SPI_CTRLA_SWRST;
+	while (dev->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_SWRST);
+        NVIC_SetPriority(dev->irqn, configLIBRARY_API_CALL_INTERRUPT_PRIORITY);
+        NVIC_ClearPendingIRQ(dev->irqn);
+	NVIC_EnableIRQ(dev->irqn);
+	dev->mmio->BAUD.reg = dev->reg_baud;
+	dev->mmio->ADDR.reg = dev->reg_addr;
+	dev->mmio->CTRLB.reg = dev->reg_ctrlb;
+        while (dev->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_CTRLB);
+	dev->mmio->CTRLA.reg = dev->reg_ctrla;
+        dev->mmio->CTRLA.reg |= SERCOM_SPI_CTRLA_ENABLE;
+	while (dev->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE);
+	dev->conf_pins(SPI_CONF_PINS);
+#if SPI_SLAVE == 1
+	if (m == SPI_SLAVE_MODE) {
+		slv_start(dev);
+	}
+#endif
+}
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * enable_spi
+ */
+void enable_spi(void *dev)
+{
+        uint8_t u8;
+
+        enable_clk_channel(((spi) dev)->clk_chn, ((spi) dev)->clk_gen);
+        enable_per_apb_clk(((spi) dev)->apb_bus_ins, ((spi) dev)->apb_mask);
+	((spi) dev)->mmio->CTRLA.reg = SERCOM_SPI_CTRLA_SWRST;
+	while (((spi) dev)->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_SWRST);
+        NVIC_ClearPendingIRQ(((spi) dev)->irqn);
+	NVIC_EnableIRQ(((spi) dev)->irqn);
+	((spi) dev)->mmio->BAUD.reg = ((spi) dev)->reg_baud;
+	((spi) dev)->mmio->ADDR.reg = ((spi) dev)->reg_addr;
+	((spi) dev)->mmio->CTRLB.reg = ((spi) dev)->reg_ctrlb;
+        while (((spi) dev)->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_CTRLB);
+	((spi) dev)->mmio->CTRLA.reg = ((spi) dev)->reg_ctrla;
+        ((spi) dev)->mmio->CTRLA.reg |= SERCOM_SPI_CTRLA_ENABLE;
+	while (((spi) dev)->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE);
+	while (pdTRUE == xQueueReceive(((spi) dev)->sig_que, &u8, 0));
+	((spi) dev)->conf_pins(SPI_CONF_PINS);
+#if SPI_SLAVE == 1
+	if (((spi) dev)->mode == SPI_SLAVE_MODE) {
+		slv_start(dev);
+	}
+#endif
+}
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * disable_spi
+ */
+void disable_spi(void *dev)
+{
+	NVIC_DisableIRQ(((spi) dev)->irqn);
+	((spi) dev)->mmio->CTRLA.reg &= ~SERCOM_SPI_CTRLA_ENABLE;
+        while (((spi) dev)->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE ||
+	       ((spi) dev)->mmio->CTRLA.reg & SERCOM_SPI_CTRLA_ENABLE);
+	((spi) dev)->conf_pins(SPI_PINS_TO_PORT);
+	disable_clk_channel(((spi) dev)->clk_chn);
+	disable_per_apb_clk(((spi) dev)->apb_bus_ins, ((spi) dev)->apb_mask);
+#if DMAC_ON_CHIP == 1
+	if (((spi) dev)->dma) {
+		disable_dmac_channel(((spi) dev)->rx_channel);
+		disable_dmac_channel(((spi) dev)->tx_channel);
+	}
+#endif
+#if SPI_SLAVE == 1
+	if (((spi) dev)->mode == SPI_SLAVE_MODE && ((spi) dev)->slv_cur >= 0) {
+		((spi) dev)->slv_free |= 1 << ((spi) dev)->slv_cur;
+		((spi) dev)->slv_cur = -1;
+	}
+#endif
+}
+#endif
+
+#if SPI_MASTER == 1
+/**
+ * spi_transfer
+ */
+int spi_transfer(void *dev, const void *tx, void *rx, int size)
+{
+	uint8_t er;
+
+	if (size < 1) {
+                return (0);
+        }
+	while (((spi) dev)->mmio->INTFLAG.reg & SERCOM_SPI_INTFLAG_RXC) {
+		((spi) dev)->dummy_rx = ((spi) dev)->mmio->DATA.reg;
+	}
+	((spi) dev)->mmio->STATUS.reg = SERCOM_SPI_STATUS_BUFOVF;
+#if DMAC_ON_CHIP == 1
+	if (((spi) dev)->dma && size > 2) {
+		return (dma_transfer(dev, tx, rx, size));
+	}
+#endif
+	((spi) dev)->size = size;
+	((spi) dev)->tx_cnt = size;
+	((spi) dev)->p_tx = tx;
+	((spi) dev)->p_rx = rx;
+	put_char(dev);
+        barrier();
+	((spi) dev)->mmio->INTENSET.reg = SERCOM_SPI_INTENSET_RXC;
+	xQueueReceive(((spi) dev)->sig_que, &er, portMAX_DELAY);
+	return (0);
+}
+#endif
+
+#if SPI_MASTER == 1
+/**
+ * spi_reconf
+ */
+void spi_reconf(void *dev, int baudrate, enum spi_clk_mode clk_mode, enum spi_bit_order bit_order)
+{
+	((spi) dev)->baudrate = baudrate;
+	((spi) dev)->clk_mode = clk_mode;
+	((spi) dev)->bit_order = bit_order;
+	((spi) dev)->reg_baud = baud_reg(dev);
+	((spi) dev)->reg_ctrla &= ~(SERCOM_SPI_CTRLA_CPOL | SERCOM_SPI_CTRLA_CPHA | SERCOM_SPI_CTRLA_DORD);
+	if (bit_order == SPI_BIT_ORDER_LSB) {
+		((spi) dev)->reg_ctrla |= SERCOM_SPI_CTRLA_DORD;
+	}
+	if (clk_mode == SPI_CLK_MODE_1 || clk_mode == SPI_CLK_MODE_3) {
+		((spi) dev)->reg_ctrla |= SERCOM_SPI_CTRLA_CPHA;
+	}
+	if (clk_mode == SPI_CLK_MODE_2 || clk_mode == SPI_CLK_MODE_3) {
+		((spi) dev)->reg_ctrla |= SERCOM_SPI_CTRLA_CPOL;
+	}
+	((spi) dev)->mmio->CTRLA.reg &= ~SERCOM_SPI_CTRLA_ENABLE;
+        while (((spi) dev)->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE);
+	((spi) dev)->mmio->BAUD.reg = ((spi) dev)->reg_baud;
+	((spi) dev)->mmio->CTRLA.reg = ((spi) dev)->reg_ctrla;
+        ((spi) dev)->mmio->CTRLA.reg |= SERCOM_SPI_CTRLA_ENABLE;
+	while (((spi) dev)->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE);
+}
+#endif
+
+#if DMAC_ON_CHIP == 1 && SPI_MASTER == 1
+/**
+ * dma_transfer
+ */
+static int dma_transfer(spi dev, const void *tx, void *rx, int size)
+{
+	DmacDescriptor *desc;
+	unsigned int beat;
+	uint8_t er;
+
+	if (dev->char_size == SPI_CHAR_SIZE_9_BITS) {
+		beat = DMAC_BTCTRL_BEATSIZE_HWORD;
+		size *= 2;
+	} else {
+		beat = DMAC_BTCTRL_BEATSIZE_BYTE;
+	}
+	desc = dev->rx_channel->trans_desc;
+	desc->BTCTRL.reg = beat | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = (beat == DMAC_BTCTRL_BEATSIZE_HWORD) ? size / 2 : size;
+	desc->SRCADDR.reg = (unsigned int) &dev->mmio->DATA.reg;
+	if (rx) {
+		desc->BTCTRL.reg |= DMAC_BTCTRL_DSTINC;
+		desc->DSTADDR.reg = (unsigned int) rx + size;
+	} else {
+		desc->DSTADDR.reg = (unsigned int) &dev->dummy_rx;
+	}
+        desc->DESCADDR.reg = 0;
+	desc = dev->tx_channel->trans_desc;
+	desc->BTCTRL.reg = beat | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = dev->rx_channel->trans_desc->BTCNT.reg;
+	if (tx) {
+		desc->BTCTRL.reg |= DMAC_BTCTRL_SRCINC;
+		desc->SRCADDR.reg = (unsigned int) tx + size;
+	} else {
+		desc->SRCADDR.reg = (unsigned int) &dev->dummy_tx;
+	}
+	desc->DSTADDR.reg = (unsigned int) &dev->mmio->DATA.reg;
+        desc->DESCADDR.reg = 0;
+	enable_dmac_transfer(dev->rx_channel);
+	enable_dmac_transfer(dev->tx_channel);
+	xQueueReceive(dev->sig_que, &er, portMAX_DELAY);
+	if (er) {
+		reset_dmac_channel(dev->rx_channel);
+		reset_dmac_channel(dev->tx_channel);
+		while (pdTRUE == xQueueReceive(dev->sig_que, &er, 0));
+		return (-EDMA);
+	}
+	return (0);
+}
+#endif
+
+#if SPI_MASTER == 1
+/**
+ * put_char
+ */
+static inline void put_char(spi dev)
+{
+	if (dev->p_tx) {
+		if (dev->char_size == SPI_CHAR_SIZE_9_BITS) {
+			dev->mmio->DATA.reg = *((const uint16_t *) dev->p_tx);
+			dev->p_tx = (const uint16_t *) dev->p_tx + 1;
+		} else {
+			dev->mmio->DATA.reg = *((const uint8_t *) dev->p_tx);
+			dev->p_tx = (const uint8_t *) dev->p_tx + 1;
+		}
+	} else {
+		dev->mmio->DATA.reg = dev->dummy_tx;
+	}
+	dev->tx_cnt--;
+}
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * spi_hndlr
+ */
+static BaseType_t spi_hndlr(void *dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+
+#if SPI_SLAVE == 1
+	if (((spi) dev)->mode == SPI_SLAVE_MODE) {
+		return (slv_hndlr(dev));
+	}
+#endif
+#if SPI_MASTER == 1
+	if (((spi) dev)->mmio->INTENSET.reg & SERCOM_SPI_INTENSET_RXC &&
+	    ((spi) dev)->mmio->INTFLAG.reg & SERCOM_SPI_INTFLAG_RXC) {
+		uint16_t d = ((spi) dev)->mmio->DATA.reg;
+		if (((spi) dev)->p_rx) {
+			if (((spi) dev)->char_size == SPI_CHAR_SIZE_9_BITS) {
+				*((uint16_t *) ((spi) dev)->p_rx) = d & 0x01FF;
+				((spi) dev)->p_rx = (uint16_t *) ((spi) dev)->p_rx + 1;
+			} else {
+				*((uint8_t *) ((spi) dev)->p_rx) = d;
+				((spi) dev)->p_rx = (uint8_t *) ((spi) dev)->p_rx + 1;
+			}
+		}
+		if (--((spi) dev)->size == 0) {
+			((spi) dev)->mmio->INTENCLR.reg = SERCOM_SPI_INTENCLR_RXC;
+			uint8_t er = 0;
+			xQueueSendFromISR(((spi) dev)->sig_que, &er, &tsk_wkn);
+		} else if (((spi) dev)->tx_cnt) {
+			put_char(dev);
+		}
+	}
+#endif
+        return (tsk_wkn);
+}
+#endif
+
+#if DMAC_ON_CHIP == 1 && (SPI_MASTER == 1 || SPI_SLAVE == 1)
+/**
+ * rx_dma_hndlr
+ */
+static BaseType_t rx_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	uint8_t er = (intr == DMAC_TCMPL_INTR) ? 0 : 1;
+
+	disable_dmac_channel_intr(((spi) dev)->rx_channel);
+#if SPI_SLAVE == 1
+	if (((spi) dev)->mode == SPI_SLAVE_MODE) {
+		if (er) {
+			((spi) dev)->slv_dma_err = TRUE;
+		}
+		return (pdFALSE);
+	}
+#endif
+	xQueueSendFromISR(((spi) dev)->sig_que, &er, &tsk_wkn);
+	return (tsk_wkn);
+}
+#endif
+
+#if DMAC_ON_CHIP == 1 && (SPI_MASTER == 1 || SPI_SLAVE == 1)
+/**
+ * tx_dma_hndlr
+ */
+static BaseType_t tx_dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	uint8_t er = 1;
+
+	disable_dmac_channel_intr(((spi) dev)->tx_channel);
+	if (intr != DMAC_TCMPL_INTR) {
+#if SPI_SLAVE == 1
+		if (((spi) dev)->mode == SPI_SLAVE_MODE) {
+			((spi) dev)->slv_dma_err = TRUE;
+			return (pdFALSE);
+		}
+#endif
+		xQueueSendFromISR(((spi) dev)->sig_que, &er, &tsk_wkn);
+	}
+	return (tsk_wkn);
+}
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * spi_slave_rcv
+ */
+int spi_slave_rcv(void *dev, int *p_buf, TickType_t tmo)
+{
+	struct slv_msg msg;
+
+	if (pdFALSE == xQueueReceive(((spi) dev)->slv_que, &msg, tmo)) {
+		return (-ETMO);
+	}
+	*p_buf = msg.buf;
+	if (msg.err) {
+		return (-EDMA);
+	}
+	return (msg.size);
+}
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * spi_slave_release
+ */
+void spi_slave_release(void *dev, int buf)
+{
+	if (buf != 0 && buf != 1) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	taskENTER_CRITICAL();
+	((spi) dev)->slv_free |= 1 << buf;
+	// Arm before next SS assertion, DMA armed after SS low misses first chars.
+	if (((spi) dev)->slv_cur < 0 && !((spi) dev)->slv_sel &&
+	    !(((spi) dev)->mmio->INTFLAG.reg & SERCOM_SPI_INTFLAG_SSL)) {
+		slv_arm(dev, buf);
+	}
+	taskEXIT_CRITICAL();
+}
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * slv_hndlr
+ */
+static BaseType_t slv_hndlr(spi dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	struct slv_msg msg;
+	int nxt;
+
+	if (dev->mmio->INTENSET.reg & SERCOM_SPI_INTENSET_SSL &&
+	    dev->mmio->INTFLAG.reg & SERCOM_SPI_INTFLAG_SSL) {
+		dev->mmio->INTFLAG.reg = SERCOM_SPI_INTFLAG_SSL;
+		if (dev->slv_cur < 0) {
+			// Transaction without armed DMA is dropped at its end.
+			dev->slv_sel = TRUE;
+		}
+	}
+	if (dev->mmio->INTFLAG.reg & SERCOM_SPI_INTFLAG_TXC) {
+		dev->mmio->INTFLAG.reg = SERCOM_SPI_INTFLAG_TXC;
+		if (dev->slv_cur < 0) {
+			slv_flush(dev);
+			dev->slv_drop_cnt++;
+			dev->slv_sel = FALSE;
+			if (dev->slv_free) {
+				slv_arm(dev, (dev->slv_free & 0x01) ? 0 : 1);
+			}
+			return (tsk_wkn);
+		}
+#if DMAC_ON_CHIP == 1
+		msg.size = dmac_channel_abort_isr(dev->rx_channel);
+		dmac_channel_abort_isr(dev->tx_channel);
+#else
+		msg.size = 0;
+#endif
+		slv_flush(dev);
+		msg.buf = dev->slv_cur;
+		msg.err = dev->slv_dma_err;
+		dev->slv_dma_err = FALSE;
+		xQueueSendFromISR(dev->slv_que, &msg, &tsk_wkn);
+		nxt = dev->slv_cur ^ 1;
+		if (dev->slv_free & (1 << nxt)) {
+			slv_arm(dev, nxt);
+		} else {
+			dev->slv_cur = -1;
+			dev->mmio->INTFLAG.reg = SERCOM_SPI_INTFLAG_SSL;
+			dev->mmio->INTENSET.reg = SERCOM_SPI_INTENSET_SSL;
+		}
+	}
+	return (tsk_wkn);
+}
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * slv_start
+ */
+static void slv_start(spi dev)
+{
+	taskENTER_CRITICAL();
+	dev->slv_dma_err = FALSE;
+	dev->slv_sel = FALSE;
+	if (dev->slv_free) {
+		slv_arm(dev, (dev->slv_free & 0x01) ? 0 : 1);
+	} else {
+		dev->mmio->INTENSET.reg = SERCOM_SPI_INTENSET_SSL;
+	}
+	dev->mmio->INTENSET.reg = SERCOM_SPI_INTENSET_TXC;
+	taskEXIT_CRITICAL();
+}
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * slv_arm
+ */
+static void slv_arm(spi dev, int buf)
+{
+#if DMAC_ON_CHIP == 1
+	DmacDescriptor *desc;
+
+	desc = dev->rx_channel->trans_desc;
+	desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_DSTINC | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = dev->slv_buf_size;
+	desc->SRCADDR.reg = (unsigned int) &dev->mmio->DATA.reg;
+	desc->DSTADDR.reg = (unsigned int) (dev->slv_rx_buf[buf] + dev->slv_buf_size);
+        desc->DESCADDR.reg = 0;
+	desc = dev->tx_channel->trans_desc;
+	desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_SRCINC | DMAC_BTCTRL_VALID;
+	desc->BTCNT.reg = dev->slv_buf_size;
+	desc->SRCADDR.reg = (unsigned int) (dev->slv_tx_buf[buf] + dev->slv_buf_size);
+	desc->DSTADDR.reg = (unsigned int) &dev->mmio->DATA.reg;
+        desc->DESCADDR.reg = 0;
+#endif
+	dev->slv_free &= ~(1 << buf);
+	dev->slv_cur = buf;
+	dev->mmio->INTENCLR.reg = SERCOM_SPI_INTENCLR_SSL;
+#if DMAC_ON_CHIP == 1
+	enable_dmac_transfer_isr(dev->rx_channel);
+	enable_dmac_transfer_isr(dev->tx_channel);
+#endif
+}
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * slv_flush
+ *
+ * Drop chars preloaded into SERCOM buffers (SERCOM disable/enable).
+ */
+static void slv_flush(spi dev)
+{
+	dev->mmio->CTRLA.reg &= ~SERCOM_SPI_CTRLA_ENABLE;
+        while (dev->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE);
+	dev->mmio->STATUS.reg = SERCOM_SPI_STATUS_BUFOVF;
+        dev->mmio->CTRLA.reg |= SERCOM_SPI_CTRLA_ENABLE;
+        while (dev->mmio->SYNCBUSY.reg & SERCOM_SPI_SYNCBUSY_ENABLE);
+}
+#endif
+
+#if SPI_MASTER == 1
+/**
+ * baud_reg
+ */
+static uint8_t baud_reg(spi dev)
+{
+	int baud;
+
+	if (2 * dev->baudrate > dev->sercom_clock) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	baud = (dev->sercom_clock + 2 * dev->baudrate - 1) / (2 * dev->baudrate) - 1;
+	if (baud > 255) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	return (baud);
+}
+#endif
@@ -0,0 +1,250 @@
+/*
+ * spi.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SPI_H
+#define SPI_H
+
+#ifndef SPI_MASTER
+ #define SPI_MASTER 0
+#endif
+#ifndef SPI_SLAVE
+ #define SPI_SLAVE 0
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+ #include "dmac.h"
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+enum spi_mode {
+	SPI_MASTER_MODE,
+	SPI_SLAVE_MODE
+};
+
+enum spi_clk_mode {
+	SPI_CLK_MODE_0, // CPOL=0, CPHA=0.
+	SPI_CLK_MODE_1, // CPOL=0, CPHA=1.
+        SPI_CLK_MODE_2, // CPOL=1, CPHA=0.
+        SPI_CLK_MODE_3  // CPOL=1, CPHA=1.
+};
+
+enum spi_bit_order {
+	SPI_BIT_ORDER_MSB,
+	SPI_BIT_ORDER_LSB
+};
+
+enum spi_char_size {
+	SPI_CHAR_SIZE_8_BITS,
+	SPI_CHAR_SIZE_9_BITS
+};
+
+enum spi_standby {
+	SPI_STANDBY_ONDEMAND,
+	SPI_STANDBY_ACTIVE
+};
+
+enum spi_di_pad {
+	SPI_DI_SERCOM_PAD0,
+        SPI_DI_SERCOM_PAD1,
+        SPI_DI_SERCOM_PAD2,
+        SPI_DI_SERCOM_PAD3
+};
+
+enum spi_do_pad {
+	SPI_DO_PAD0_SCK_PAD1_SS_PAD2,
+	SPI_DO_PAD2_SCK_PAD3_SS_PAD1,
+        SPI_DO_PAD3_SCK_PAD1_SS_PAD2,
+        SPI_DO_PAD0_SCK_PAD3_SS_PAD1
+};
+
+enum spi_addr_mode {
+	SPI_ADDR_MODE_OFF,
+	SPI_ADDR_MODE_MASK,
+        SPI_ADDR_MODE_2_ADDRS,
+        SPI_ADDR_MODE_RANGE
+};
+
+enum spi_conf_pins_cmd {
+	SPI_CONF_PINS,
+	SPI_PINS_TO_PORT
+};
+
+typedef struct spi_dsc *spi;
+
+struct spi_dsc {
+	int id; // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	int baudrate; // <SetIt> [SPI_MASTER_MODE]
+	int clk_gen; // <SetIt> - GCLK instance for sercom_clock. [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	int sercom_clock; // <SetIt> - GCLK frequency. [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	void (*conf_pins)(enum spi_conf_pins_cmd); // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	enum spi_clk_mode clk_mode; // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	enum spi_bit_order bit_order; // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	enum spi_char_size char_size; // <SetIt> [SPI_MASTER_MODE]
+        enum spi_standby standby; // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+        enum spi_di_pad di_pad; // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+        enum spi_do_pad do_pad; // <SetIt> [SPI_MASTER_MODE, SPI_SLAVE_MODE]
+	boolean_t hw_ss; // <SetIt> - SS driven by SERCOM (MSSEN). [SPI_MASTER_MODE]
+        boolean_t dma; // <SetIt> [SPI_MASTER_MODE]
+        enum spi_addr_mode addr_mode; // <SetIt> [SPI_SLAVE_MODE]
+	uint8_t addr; // <SetIt> [SPI_SLAVE_MODE]
+	uint8_t addr_mask; // <SetIt> - Mask, second address or upper limit. [SPI_SLAVE_MODE]
+	uint8_t *slv_rx_buf[2]; // <SetIt> [SPI_SLAVE_MODE]
+	uint8_t *slv_tx_buf[2]; // <SetIt> [SPI_SLAVE_MODE]
+	int slv_buf_size; // <SetIt> [SPI_SLAVE_MODE]
+#if DMAC_ON_CHIP == 1
+        dmac_channel rx_channel;
+        dmac_channel tx_channel;
+	int dmac_rx_trg_num;
+	int dmac_tx_trg_num;
+#endif
+        SercomSpi *mmio;
+	unsigned int reg_ctrla;
+	unsigned int reg_ctrlb;
+	unsigned int reg_addr;
+	uint8_t reg_baud;
+        enum apb_bus_ins apb_bus_ins;
+	unsigned int apb_mask;
+	int clk_chn;
+        IRQn_Type irqn;
+        QueueHandle_t sig_que;
+	int size;
+	int tx_cnt;
+	const void *p_tx;
+	void *p_rx;
+	uint16_t dummy_tx;
+	uint16_t dummy_rx;
+	enum spi_mode mode;
+#if SPI_SLAVE == 1
+        QueueHandle_t slv_que;
+	int slv_cur;
+	int slv_free;
+	boolean_t slv_dma_err;
+	boolean_t slv_sel;
+	unsigned int slv_drop_cnt;
+#endif
+};
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * init_spi
+ *
+ * Configure SERCOM instance as SPI in requested mode.
+ *
+ * @dev: SPI instance.
+ * @m: SPI mode (enum spi_mode).
+ */
+void init_spi(spi dev, enum spi_mode m);
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * enable_spi
+ *
+ * Enable SPI (revert disable_spi() function effects).
+ *
+ * @dev: SPI instance.
+ */
+void enable_spi(void *dev);
+#endif
+
+#if SPI_MASTER == 1 || SPI_SLAVE == 1
+/**
+ * disable_spi
+ *
+ * Disable SPI (switch SERCOM block and SPI DMAC channels off).
+ *
+ * @dev: SPI instance.
+ */
+void disable_spi(void *dev);
+#endif
+
+#if SPI_MASTER == 1
+/**
+ * spi_transfer
+ *
+ * Full-duplex transfer via SPI instance. Transfers longer than 2 chars
+ * are moved by paired RX/TX DMA channels (dev->dma TRUE).
+ * Caller task is blocked during transfer.
+ *
+ * @dev: SPI instance.
+ * @tx: Pointer to data to send (bytes or half-words (CHAR9)) or NULL
+ *   (0xFF chars are sent).
+ * @rx: Pointer to buffer for received data or NULL (data are dropped).
+ * @size: Number of chars to transfer.
+ *
+ * Returns: 0 - success; -EDMA - dma error.
+ */
+int spi_transfer(void *dev, const void *tx, void *rx, int size);
+#endif
+
+#if SPI_MASTER == 1
+/**
+ * spi_reconf
+ *
+ * Change clock rate and clock mode of SPI master (SERCOM is shortly
+ * disabled, must not be called during transfer).
+ *
+ * @dev: SPI instance.
+ * @baudrate: SCK frequency.
+ * @clk_mode: Clock polarity and phase.
+ * @bit_order: Data order.
+ */
+void spi_reconf(void *dev, int baudrate, enum spi_clk_mode clk_mode, enum spi_bit_order bit_order);
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * spi_slave_rcv
+ *
+ * Wait for end of SPI slave transaction. Transaction data are moved by DMA
+ * to/from pair of buffers dev->slv_rx_buf[buf] and dev->slv_tx_buf[buf],
+ * next transaction uses the other pair. Buffer pair is owned by caller
+ * until spi_slave_release() is called. If both pairs are owned by caller
+ * when transaction ends, slave is re-armed at SS low of the first
+ * transaction after one pair is released (transactions in between are
+ * dropped and counted).
+ * In address mode (addr_mode) transactions addressed to other slaves are
+ * ignored by hardware, first received char is the address.
+ *
+ * @dev: SPI instance.
+ * @p_buf: Pointer to memory for store index of buffer pair.
+ * @tmo: Timeout in tick periods.
+ *
+ * Returns: Number of received chars; -ETMO - no transaction in tmo time;
+ *          -EDMA - dma error (buffer pair must be released).
+ */
+int spi_slave_rcv(void *dev, int *p_buf, TickType_t tmo);
+#endif
+
+#if SPI_SLAVE == 1
+/**
+ * spi_slave_release
+ *
+ * Return buffer pair to SPI slave. Data in dev->slv_tx_buf[buf] are sent
+ * in transaction which uses this pair next time. If no buffer pair is armed
+ * and SS is idle, DMA is armed immediately. Transaction started while no
+ * buffer pair was armed is dropped.
+ *
+ * @dev: SPI instance.
+ * @buf: Index of buffer pair.
+ */
+void spi_slave_release(void *dev, int buf);
+#endif
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * spibus.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "dmac.h"
+#include "port.h"
+#include "spi.h"
+#include "spibus.h"
+
+#if SPIBUS == 1
+
+static void insert_dev(spibus bus, spibus_dev dev);
+static spibus_dev pick_dev(spibus bus);
+
+/**
+ * init_spibus
+ */
+void init_spibus(spibus bus)
+{
+	if (bus->spi == NULL || bus->spi->mode != SPI_MASTER_MODE) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	bus->cur = NULL;
+	bus->pend = NULL;
+	bus->busy = FALSE;
+	bus->batch = 0;
+	bus->xfer_cnt = 0;
+	bus->reconf_cnt = 0;
+}
+
+/**
+ * add_spibus_dev
+ */
+void add_spibus_dev(spibus_dev dev)
+{
+	if (dev->bus == NULL || dev->cs_port == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (NULL == (dev->grant = xSemaphoreCreateBinary())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	dev->wait_cnt = 0;
+	conf_pin(dev->cs_pin, dev->cs_port, PIN_FUNC_OUTPUT_HIGH, PIN_FEAT_END);
+}
+
+/**
+ * spibus_set_baudrate
+ */
+void spibus_set_baudrate(spibus_dev dev, int baudrate)
+{
+	taskENTER_CRITICAL();
+	dev->baudrate = baudrate;
+	if (dev->bus->cur == dev) {
+		dev->bus->cur = NULL;
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * spibus_acquire
+ */
+void spibus_acquire(spibus_dev dev)
+{
+	spibus bus = dev->bus;
+	boolean_t granted = FALSE;
+
+	taskENTER_CRITICAL();
+	if (!bus->busy) {
+		bus->busy = TRUE;
+		bus->batch = (bus->cur == dev) ? bus->batch + 1 : 0;
+		granted = TRUE;
+	} else if (dev->wait_cnt++ == 0) {
+		insert_dev(bus, dev);
+	}
+	taskEXIT_CRITICAL();
+	if (!granted) {
+		xSemaphoreTake(dev->grant, portMAX_DELAY);
+	}
+	if (bus->cur != dev) {
+		spi_reconf(bus->spi, dev->baudrate, dev->clk_mode, dev->bit_order);
+		bus->cur = dev;
+		bus->reconf_cnt++;
+	}
+}
+
+/**
+ * spibus_release
+ */
+void spibus_release(spibus_dev dev)
+{
+	spibus bus = dev->bus;
+	spibus_dev d;
+
+	taskENTER_CRITICAL();
+	if (NULL == (d = pick_dev(bus))) {
+		bus->busy = FALSE;
+	}
+	taskEXIT_CRITICAL();
+	if (d) {
+		// Bus is granted to one of tasks waiting for device d.
+		xSemaphoreGive(d->grant);
+	}
+}
+
+/**
+ * spibus_cs
+ */
+void spibus_cs(spibus_dev dev, boolean_t act)
+{
+	set_pin_lev(dev->cs_pin, dev->cs_port, (act) ? LOW : HIGH);
+}
+
+/**
+ * spibus_xfer
+ */
+int spibus_xfer(spibus_dev dev, struct spibus_seg *seg, int n)
+{
+	int ret = 0;
+
+	spibus_acquire(dev);
+	spibus_cs(dev, TRUE);
+	for (int i = 0; i < n && !ret; i++) {
+		ret = spi_transfer(dev->bus->spi, seg[i].tx, seg[i].rx, seg[i].size);
+	}
+	spibus_cs(dev, FALSE);
+	dev->bus->xfer_cnt++;
+	spibus_release(dev);
+	return (ret);
+}
+
+/**
+ * insert_dev
+ *
+ * Insert device with waiting tasks into pending list ordered by priority
+ * (critical section).
+ */
+static void insert_dev(spibus bus, spibus_dev dev)
+{
+	spibus_dev *pp = &bus->pend;
+
+	while (*pp && (*pp)->prio >= dev->prio) {
+		pp = &(*pp)->next;
+	}
+	dev->next = *pp;
+	*pp = dev;
+}
+
+/**
+ * pick_dev
+ *
+ * Take next device from pending list (critical section). Current device is
+ * preferred within the highest pending priority until SPIBUS_BATCH_MAX
+ * consecutive grants. Device with more waiting tasks is moved behind
+ * devices of the same priority.
+ */
+static spibus_dev pick_dev(spibus bus)
+{
+	spibus_dev *pp, d = NULL;
+
+	if (!bus->pend) {
+		return (NULL);
+	}
+	if (bus->batch < SPIBUS_BATCH_MAX - 1) {
+		for (pp = &bus->pend; *pp && (*pp)->prio == bus->pend->prio; pp = &(*pp)->next) {
+			if (*pp == bus->cur) {
+				d = *pp;
+				*pp = d->next;
+				bus->batch++;
+				break;
+			}
+		}
+	}
+	if (!d) {
+		d = bus->pend;
+		bus->pend = d->next;
+		bus->batch = (d == bus->cur) ? bus->batch + 1 : 0;
+	}
+	if (--d->wait_cnt) {
+		insert_dev(bus, d);
+	}
+	return (d);
+}
+
+#if TERMOUT == 1
+/**
+ * log_spibus_stats
+ */
+void log_spibus_stats(spibus bus)
+{
+	msg(INF, "spibus.c: xfer_cnt=%u reconf_cnt=%u\n", bus->xfer_cnt, bus->reconf_cnt);
+}
+#endif
+
+#endif
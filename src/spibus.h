@@ -0,0 +1,150 @@
+/*
+ * spibus.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SPIBUS_H
+#define SPIBUS_H
+
+#ifndef SPIBUS
+ #define SPIBUS 0
+#endif
+#ifndef SPIBUS_BATCH_MAX
+ #define SPIBUS_BATCH_MAX 4
+#endif
+
+#if SPIBUS == 1
+
+#include "spi.h"
+#include "port.h"
+
+struct spibus_seg {
+	const void *tx; // NULL - 0xFF chars are sent.
+	void *rx; // NULL - received chars are dropped.
+	int size;
+};
+
+typedef struct spibus_dsc *spibus;
+typedef struct spibus_dev_dsc *spibus_dev;
+
+struct spibus_dsc {
+	spi spi; // <SetIt> - Initialized SPI master instance.
+	spibus_dev cur;
+	spibus_dev pend;
+	boolean_t busy;
+	int batch;
+	unsigned int xfer_cnt;
+	unsigned int reconf_cnt;
+};
+
+struct spibus_dev_dsc {
+	spibus bus; // <SetIt>
+	int baudrate; // <SetIt>
+	enum spi_clk_mode clk_mode; // <SetIt>
+	enum spi_bit_order bit_order; // <SetIt>
+	int cs_pin; // <SetIt>
+	PortGroup *cs_port; // <SetIt>
+	int prio; // <SetIt> - Bus access priority (higher value first).
+	SemaphoreHandle_t grant;
+	int wait_cnt;
+	struct spibus_dev_dsc *next;
+};
+
+/**
+ * init_spibus
+ *
+ * Initialize SPI bus manager.
+ *
+ * @bus: SPI bus instance.
+ */
+void init_spibus(spibus bus);
+
+/**
+ * add_spibus_dev
+ *
+ * Register device on SPI bus (CS pin is configured as output high).
+ *
+ * @dev: SPI bus device instance.
+ */
+void add_spibus_dev(spibus_dev dev);
+
+/**
+ * spibus_set_baudrate
+ *
+ * Change SCK frequency of device (SERCOM is reconfigured by the next
+ * spibus_acquire()).
+ *
+ * @dev: SPI bus device instance.
+ * @baudrate: SCK frequency.
+ */
+void spibus_set_baudrate(spibus_dev dev, int baudrate);
+
+/**
+ * spibus_acquire
+ *
+ * Get exclusive bus access for device. Waiting tasks get bus in order of
+ * device priority, FIFO within the same priority. Up to SPIBUS_BATCH_MAX
+ * consecutive requests of device which owns the bus are preferred among
+ * requests with the highest waiting priority. SERCOM is reconfigured only
+ * if the bus was used by another device last time. Waiting task blocks on
+ * grant semaphore of device, task notifications are not used.
+ *
+ * @dev: SPI bus device instance.
+ */
+void spibus_acquire(spibus_dev dev);
+
+/**
+ * spibus_release
+ *
+ * Release bus access acquired by spibus_acquire().
+ *
+ * @dev: SPI bus device instance.
+ */
+void spibus_release(spibus_dev dev);
+
+/**
+ * spibus_cs
+ *
+ * Set CS pin of device (bus must be acquired).
+ *
+ * @dev: SPI bus device instance.
+ * @act: TRUE - CS low (active), FALSE - CS high.
+ */
+void spibus_cs(spibus_dev dev, boolean_t act);
+
+/**
+ * spibus_xfer
+ *
+ * Transfer segments with CS active (bus is acquired and released).
+ * Caller task is blocked during transfer.
+ *
+ * @dev: SPI bus device instance.
+ * @seg: Array of segments.
+ * @n: Number of segments.
+ *
+ * Returns: 0 - success; -EDMA - dma error.
+ */
+int spibus_xfer(spibus_dev dev, struct spibus_seg *seg, int n);
+
+#if TERMOUT == 1
+/**
+ * log_spibus_stats
+ */
+void log_spibus_stats(spibus bus);
+#endif
+#endif
+
+#endif
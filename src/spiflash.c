@@ -0,0 +1,313 @@
+/*
+ * spiflash.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "dmac.h"
+#include "port.h"
+#include "spi.h"
+#include "spibus.h"
+#include "spiflash.h"
+#include <string.h>
+
+#if SPIFLASH == 1
+
+#define CMD_WREN      0x06
+#define CMD_RDSR1     0x05
+#define CMD_FAST_READ 0x0B
+#define CMD_PP        0x02
+#define CMD_SE        0x20
+#define SR1_WIP       0x01
+
+static void spiflash_tsk(void *p);
+static int cmd_addr(spiflash dev, uint8_t cmd, int addr, const void *tx, void *rx, int size);
+static int read_sr(spiflash dev, uint8_t *sr);
+static void inval_cache(spiflash dev, int addr, int size);
+
+/**
+ * init_spiflash
+ */
+void init_spiflash(spiflash dev)
+{
+	if (dev->bdev == NULL || dev->size > 0x1000000) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	for (int i = 0; i < SPIFLASH_CACHE_LINES; i++) {
+		dev->cache[i].addr = -1;
+	}
+	if (NULL == (dev->rdy = xSemaphoreCreateBinary())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	xSemaphoreGive(dev->rdy);
+	if (pdPASS != xTaskCreate(spiflash_tsk, dev->tsk_nm, SPIFLASH_TASK_STACK_SIZE, dev,
+				  SPIFLASH_TASK_PRIO, &dev->tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+}
+
+/**
+ * spiflash_read
+ */
+int spiflash_read(spiflash dev, int addr, void *buf, int size)
+{
+	int ret;
+
+	if (addr < 0 || size <= 0 || addr + size > dev->size) {
+		return (-EADDR);
+	}
+	if (pdTRUE != xSemaphoreTake(dev->rdy, SPIFLASH_BUSY_TMO / portTICK_PERIOD_MS)) {
+		return (-ETMO);
+	}
+	ret = cmd_addr(dev, CMD_FAST_READ, addr, NULL, buf, size);
+	xSemaphoreGive(dev->rdy);
+	return (ret);
+}
+
+/**
+ * spiflash_read_cached
+ */
+int spiflash_read_cached(spiflash dev, int addr, void *buf, int size)
+{
+	struct spiflash_cache_line *ln;
+	int la, n, ret = 0;
+
+	if (addr < 0 || size <= 0 || addr + size > dev->size) {
+		return (-EADDR);
+	}
+	if (pdTRUE != xSemaphoreTake(dev->rdy, SPIFLASH_BUSY_TMO / portTICK_PERIOD_MS)) {
+		return (-ETMO);
+	}
+	while (size) {
+		la = addr & ~(SPIFLASH_CACHE_LINE_SIZE - 1);
+		ln = &dev->cache[0];
+		for (int i = 0; i < SPIFLASH_CACHE_LINES; i++) {
+			if (dev->cache[i].addr == la) {
+				ln = &dev->cache[i];
+				break;
+			}
+			if (dev->cache[i].addr < 0 || (ln->addr >= 0 && dev->cache[i].age < ln->age)) {
+				ln = &dev->cache[i];
+			}
+		}
+		if (ln->addr == la) {
+			dev->cache_hit++;
+		} else {
+			dev->cache_miss++;
+			ln->addr = -1;
+			if (la + SPIFLASH_CACHE_LINE_SIZE > dev->size) {
+				ret = -EADDR;
+				break;
+			}
+			if ((ret = cmd_addr(dev, CMD_FAST_READ, la, NULL, ln->data, SPIFLASH_CACHE_LINE_SIZE))) {
+				break;
+			}
+			ln->addr = la;
+		}
+		ln->age = ++dev->age;
+		n = la + SPIFLASH_CACHE_LINE_SIZE - addr;
+		if (n > size) {
+			n = size;
+		}
+		memcpy(buf, ln->data + (addr - la), n);
+		buf = (uint8_t *) buf + n;
+		addr += n;
+		size -= n;
+	}
+	xSemaphoreGive(dev->rdy);
+	return (ret);
+}
+
+/**
+ * spiflash_prog_page
+ */
+int spiflash_prog_page(spiflash dev, int addr, const void *buf, int size)
+{
+	int ret;
+
+	if (addr < 0 || size <= 0 || addr + size > dev->size ||
+	    (addr & (SPIFLASH_PAGE_SIZE - 1)) + size > SPIFLASH_PAGE_SIZE) {
+		return (-EADDR);
+	}
+	if (pdTRUE != xSemaphoreTake(dev->rdy, SPIFLASH_BUSY_TMO / portTICK_PERIOD_MS)) {
+		return (-ETMO);
+	}
+	inval_cache(dev, addr, size);
+	if ((ret = cmd_addr(dev, CMD_PP, addr, buf, NULL, size))) {
+		xSemaphoreGive(dev->rdy);
+	} else {
+		xTaskNotifyGive(dev->tsk_hndl);
+	}
+	return (ret);
+}
+
+/**
+ * spiflash_erase_sector
+ */
+int spiflash_erase_sector(spiflash dev, int addr)
+{
+	int ret;
+
+	if (addr < 0 || addr >= dev->size) {
+		return (-EADDR);
+	}
+	addr &= ~(SPIFLASH_SECTOR_SIZE - 1);
+	if (pdTRUE != xSemaphoreTake(dev->rdy, SPIFLASH_BUSY_TMO / portTICK_PERIOD_MS)) {
+		return (-ETMO);
+	}
+	inval_cache(dev, addr, SPIFLASH_SECTOR_SIZE);
+	if ((ret = cmd_addr(dev, CMD_SE, addr, NULL, NULL, 0))) {
+		xSemaphoreGive(dev->rdy);
+	} else {
+		xTaskNotifyGive(dev->tsk_hndl);
+	}
+	return (ret);
+}
+
+/**
+ * spiflash_sync
+ */
+int spiflash_sync(spiflash dev, TickType_t tmo)
+{
+	int ret;
+
+	if (pdTRUE != xSemaphoreTake(dev->rdy, tmo)) {
+		return (-ETMO);
+	}
+	ret = dev->err;
+	dev->err = 0;
+	xSemaphoreGive(dev->rdy);
+	return (ret);
+}
+
+/**
+ * spiflash_tsk
+ */
+static void spiflash_tsk(void *p)
+{
+	spiflash dev = p;
+	TickType_t tm;
+	uint8_t sr;
+	int ret;
+
+	while (TRUE) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		tm = xTaskGetTickCount();
+		while (TRUE) {
+			vTaskDelay(SPIFLASH_POLL_TICKS);
+			dev->poll_cnt++;
+			if (!(ret = read_sr(dev, &sr)) && !(sr & SR1_WIP)) {
+				break;
+			}
+			if (xTaskGetTickCount() - tm >= SPIFLASH_BUSY_TMO / portTICK_PERIOD_MS) {
+				dev->err = (ret) ? ret : -ETMO;
+				break;
+			}
+		}
+		xSemaphoreGive(dev->rdy);
+	}
+}
+
+/**
+ * cmd_addr
+ *
+ * Send command with 24-bit address (WREN is sent before program and
+ * erase commands) and transfer data.
+ */
+static int cmd_addr(spiflash dev, uint8_t cmd, int addr, const void *tx, void *rx, int size)
+{
+	uint8_t hdr[5];
+	int ret;
+
+	hdr[0] = cmd;
+	hdr[1] = addr >> 16;
+	hdr[2] = addr >> 8;
+	hdr[3] = addr;
+	hdr[4] = 0;
+	spibus_acquire(dev->bdev);
+	if (cmd != CMD_FAST_READ) {
+		uint8_t wren = CMD_WREN;
+
+		spibus_cs(dev->bdev, TRUE);
+		ret = spi_transfer(dev->bdev->bus->spi, &wren, NULL, 1);
+		spibus_cs(dev->bdev, FALSE);
+		if (ret) {
+			spibus_release(dev->bdev);
+			return (ret);
+		}
+	}
+	spibus_cs(dev->bdev, TRUE);
+	ret = spi_transfer(dev->bdev->bus->spi, hdr, NULL, (cmd == CMD_FAST_READ) ? 5 : 4);
+	if (!ret && size) {
+		ret = spi_transfer(dev->bdev->bus->spi, tx, rx, size);
+	}
+	spibus_cs(dev->bdev, FALSE);
+	spibus_release(dev->bdev);
+	return (ret);
+}
+
+/**
+ * read_sr
+ */
+static int read_sr(spiflash dev, uint8_t *sr)
+{
+	uint8_t buf[2] = {CMD_RDSR1, 0xFF};
+	struct spibus_seg seg = {buf, buf, 2};
+	int ret;
+
+	if (!(ret = spibus_xfer(dev->bdev, &seg, 1))) {
+		*sr = buf[1];
+	}
+	return (ret);
+}
+
+/**
+ * inval_cache
+ */
+static void inval_cache(spiflash dev, int addr, int size)
+{
+	for (int i = 0; i < SPIFLASH_CACHE_LINES; i++) {
+		if (dev->cache[i].addr >= 0 && dev->cache[i].addr < addr + size &&
+		    dev->cache[i].addr + SPIFLASH_CACHE_LINE_SIZE > addr) {
+			dev->cache[i].addr = -1;
+		}
+	}
+}
+
+#if TERMOUT == 1
+/**
+ * log_spiflash_stats
+ */
+void log_spiflash_stats(spiflash dev)
+{
+	msg(INF, "spiflash.c: <%s> cache_hit=%u cache_miss=%u poll_cnt=%u\n",
+	    dev->tsk_nm, dev->cache_hit, dev->cache_miss, dev->poll_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * spiflash.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SPIFLASH_H
+#define SPIFLASH_H
+
+#ifndef SPIFLASH
+ #define SPIFLASH 0
+#endif
+#ifndef SPIFLASH_CACHE_LINES
+ #define SPIFLASH_CACHE_LINES 4
+#endif
+#ifndef SPIFLASH_CACHE_LINE_SIZE
+ #define SPIFLASH_CACHE_LINE_SIZE 32
+#endif
+#ifndef SPIFLASH_POLL_TICKS
+ #define SPIFLASH_POLL_TICKS 1
+#endif
+#ifndef SPIFLASH_BUSY_TMO
+ #define SPIFLASH_BUSY_TMO 500
+#endif
+
+#if SPIFLASH == 1
+
+#include "spibus.h"
+
+#define SPIFLASH_PAGE_SIZE 256
+#define SPIFLASH_SECTOR_SIZE 4096
+
+struct spiflash_cache_line {
+	int addr;
+	unsigned int age;
+	uint8_t data[SPIFLASH_CACHE_LINE_SIZE];
+};
+
+typedef struct spiflash_dsc *spiflash;
+
+struct spiflash_dsc {
+	spibus_dev bdev; // <SetIt> - Registered SPI bus device.
+	int size; // <SetIt> - Flash size in bytes (max. 16 MiB).
+	const char *tsk_nm; // <SetIt>
+	TaskHandle_t tsk_hndl;
+	SemaphoreHandle_t rdy;
+	int err;
+	struct spiflash_cache_line cache[SPIFLASH_CACHE_LINES];
+	unsigned int age;
+	unsigned int cache_hit;
+	unsigned int cache_miss;
+	unsigned int poll_cnt;
+};
+
+/**
+ * init_spiflash
+ *
+ * Initialize SPI NOR flash (W25Q compatible) instance and create its WIP
+ * polling task.
+ *
+ * @dev: Flash instance.
+ */
+void init_spiflash(spiflash dev);
+
+/**
+ * spiflash_read
+ *
+ * Read data by FAST READ command (DMA is used if SPI was initialized with
+ * DMA). Waits for end of running program or erase operation.
+ *
+ * @dev: Flash instance.
+ * @addr: Flash address.
+ * @buf: Destination buffer.
+ * @size: Number of bytes.
+ *
+ * Returns: 0 - success; -EADDR - bad address; -ETMO - flash busy;
+ *   -EDMA - dma error.
+ */
+int spiflash_read(spiflash dev, int addr, void *buf, int size);
+
+/**
+ * spiflash_read_cached
+ *
+ * Read data through LRU cache of SPIFLASH_CACHE_LINES lines
+ * (for small and frequently read metadata).
+ *
+ * @dev: Flash instance.
+ * @addr: Flash address.
+ * @buf: Destination buffer.
+ * @size: Number of bytes.
+ *
+ * Returns: 0 - success; -EADDR - bad address; -ETMO - flash busy;
+ *   -EDMA - dma error.
+ */
+int spiflash_read_cached(spiflash dev, int addr, void *buf, int size);
+
+/**
+ * spiflash_prog_page
+ *
+ * Start PAGE PROGRAM. Function returns after data has been sent to flash,
+ * WIP bit is polled by flash task while caller prepares next page. Data
+ * must not cross page boundary.
+ *
+ * @dev: Flash instance.
+ * @addr: Flash address.
+ * @buf: Source buffer (can be reused after return).
+ * @size: Number of bytes (1 - SPIFLASH_PAGE_SIZE).
+ *
+ * Returns: 0 - success; -EADDR - bad address; -ETMO - flash busy;
+ *   -EDMA - dma error.
+ */
+int spiflash_prog_page(spiflash dev, int addr, const void *buf, int size);
+
+/**
+ * spiflash_erase_sector
+ *
+ * Start SECTOR ERASE (4 KiB) running in background.
+ *
+ * @dev: Flash instance.
+ * @addr: Address inside sector.
+ *
+ * Returns: 0 - success; -EADDR - bad address; -ETMO - flash busy;
+ *   -EDMA - dma error.
+ */
+int spiflash_erase_sector(spiflash dev, int addr);
+
+/**
+ * spiflash_sync
+ *
+ * Wait for end of running program or erase operation. WIP polling by flash
+ * task is bounded by SPIFLASH_BUSY_TMO ms, its error is reported (and
+ * cleared) by this function.
+ *
+ * @dev: Flash instance.
+ * @tmo: Timeout in ticks.
+ *
+ * Returns: 0 - success; -ETMO - timeout or flash busy longer than
+ *   SPIFLASH_BUSY_TMO; -EDMA - dma error while polling status.
+ */
+int spiflash_sync(spiflash dev, TickType_t tmo);
+
+#if TERMOUT == 1
+/**
+ * log_spiflash_stats
+ */
+void log_spiflash_stats(spiflash dev);
+#endif
+#endif
+
+#endif
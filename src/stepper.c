@@ -0,0 +1,412 @@
+/*
+ * stepper.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "atom.h"
+#include "msgconf.h"
+#include "criterr.h"
+#include "hwerr.h"
+#include "port.h"
+#include "tc.h"
+#include "dmac.h"
+#include "stepper.h"
+
+#if STEPPER == 1
+
+static void build(stepper dev, int n);
+static void conf_desc(stepper dev, int i, const uint16_t *src, int size, boolean_t inc);
+static int done(stepper dev);
+static void decel(stepper dev);
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr);
+static BaseType_t tc_isr_clbk(void *dev);
+
+/**
+ * init_stepper
+ */
+void init_stepper(stepper dev)
+{
+	unsigned int top;
+	int i;
+
+	if (dev->v_min < 1 || dev->ramp_max < 1 ||
+	    0 > (i = tc_fit_prescaler(dev->tc.clock_freq, 1, dev->v_min, &top))) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->tc.prescaler = i;
+	dev->tick_freq = tc_tick_freq(&dev->tc);
+	dev->pulse = (unsigned long long) dev->pulse_us * dev->tick_freq / 1000000;
+	if (!dev->pulse) {
+		dev->pulse = 1;
+	}
+	if (NULL == (dev->sig_que = xQueueCreate(1, sizeof(uint8_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	if (NULL == (dev->acc = pvPortMalloc(dev->ramp_max * sizeof(uint16_t))) ||
+	    NULL == (dev->dec = pvPortMalloc(dev->ramp_max * sizeof(uint16_t)))) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	if (dev->en_port) {
+		conf_pin(dev->en_pin, dev->en_port, (dev->en_act_lev) ? PIN_FUNC_OUTPUT_LOW : PIN_FUNC_OUTPUT_HIGH,
+		         PIN_FEAT_END);
+	}
+	conf_pin(dev->dir_pin, dev->dir_port, PIN_FUNC_OUTPUT_LOW, PIN_FEAT_END);
+	dev->tc.cnt_size = TC_CNT_SIZE_16_BIT;
+	dev->tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	dev->tc.wavegen = TC_WAVEGEN_MPWM;
+	dev->tc.direction = TC_DIRECTION_UP;
+	dev->tc.cc0 = 0xFFFF;
+	dev->tc.cc1 = dev->pulse;
+	dev->tc.chan_1_wave_inv = dev->inv;
+	dev->tc.isr_clbk = tc_isr_clbk;
+	dev->tc.conf_pins = dev->conf_pins;
+	init_tc(&dev->tc);
+	tc_stop(&dev->tc);
+	if (NULL == (dev->channel = alloc_dmac_channel())) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->channel->dev = dev;
+	dev->channel->hndlr = dma_hndlr;
+	dev->channel->trg_action = DMAC_TRG_ACTION_BEAT;
+	dev->channel->trg_source = tc_dmac_trg_num(&dev->tc, TC_DMAC_TRG_OVF);
+	dev->channel->prio_level = DMAC_CHAN_PRIO_LEVEL3;
+	stepper_profile(dev);
+}
+
+/**
+ * stepper_profile
+ */
+void stepper_profile(stepper dev)
+{
+	unsigned long long t = 0, tr, x, s;
+	unsigned int v, p, dv;
+	int i;
+
+	if (dev->busy) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (dev->v_min < 1 || dev->v_max < dev->v_min || dev->accel < 1 ||
+	    dev->tick_freq / dev->v_max <= dev->pulse) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	v = dev->v_min;
+	dv = dev->v_max - dev->v_min;
+	// S-curve v = v_min + dv * (3x^2 - 2x^3), peak acceleration 1.5 * dv / tr.
+	tr = 3ULL * dv * dev->tick_freq / (2ULL * dev->accel);
+	for (i = 0; i < dev->ramp_max; ) {
+		p = dev->tick_freq / v;
+		dev->acc[i++] = p - 1;
+		if (v >= (unsigned int) dev->v_max) {
+			break;
+		}
+		t += p;
+		if (dev->ramp == STEPPER_RAMP_TRAPEZ) {
+			v = dev->v_min + (unsigned long long) dev->accel * t / dev->tick_freq;
+		} else if (t >= tr) {
+			v = dev->v_max;
+		} else {
+			x = (t << 16) / tr;
+			s = ((3 * x * x) >> 16) - ((2 * x * x * x) >> 32);
+			v = dev->v_min + ((dv * s) >> 16);
+		}
+		if (v > (unsigned int) dev->v_max) {
+			v = dev->v_max;
+		}
+	}
+	dev->ramp_len = i;
+	for (i = 0; i < dev->ramp_len; i++) {
+		dev->dec[i] = dev->acc[dev->ramp_len - 1 - i];
+	}
+	dev->cruise = dev->acc[dev->ramp_len - 1];
+}
+
+/**
+ * stepper_move
+ */
+void stepper_move(stepper dev, int steps)
+{
+	uint8_t er;
+
+	if (dev->busy) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	if (!steps) {
+		return;
+	}
+	dev->dir = (steps > 0) ? 1 : -1;
+	set_pin_lev(dev->dir_pin, dev->dir_port, ((steps > 0) ^ dev->dir_inv) ? HIGH : LOW);
+	build(dev, (steps > 0) ? steps : -steps);
+	while (pdTRUE == xQueueReceive(dev->sig_que, &er, 0));
+	dev->busy = TRUE;
+	dev->stop_req = FALSE;
+	dev->move_cnt++;
+	tc_stop(&dev->tc);
+	tc_disable_ovf_intr(&dev->tc);
+	dev->tc.mmio->COUNT16.CTRLBCLR.reg = TC_CTRLBCLR_ONESHOT;
+	tc_sync(&dev->tc);
+	tc_set_cnt(&dev->tc, 0);
+	enable_dmac_transfer(dev->channel);
+	// First period is loaded by software trigger, next ones on overflow.
+	dmac_sw_trigger(dev->channel);
+	tc_trigger(&dev->tc);
+}
+
+/**
+ * stepper_wait
+ */
+int stepper_wait(stepper dev, TickType_t tmo)
+{
+	uint8_t er;
+
+	if (!dev->busy && pdFALSE == xQueuePeek(dev->sig_que, &er, 0)) {
+		return (0);
+	}
+	if (pdFALSE == xQueueReceive(dev->sig_que, &er, tmo)) {
+		return (-ETMO);
+	}
+	return ((er) ? -EDMA : 0);
+}
+
+/**
+ * stepper_stop
+ */
+void stepper_stop(stepper dev)
+{
+	taskENTER_CRITICAL();
+	// DMAC program is replaced by TC ISR right after overflow, so that
+	// no step period is written while descriptors are changed.
+	if (dev->busy && !dev->stop_req && dev->seg < dev->nseg - 1) {
+		dev->stop_req = TRUE;
+		tc_clear_ovf_intr(&dev->tc);
+		tc_enable_ovf_intr(&dev->tc);
+	}
+	taskEXIT_CRITICAL();
+}
+
+/**
+ * stepper_pos
+ */
+int stepper_pos(stepper dev)
+{
+	int p;
+
+	taskENTER_CRITICAL();
+	p = (dev->busy && dev->seg < dev->nseg) ? dev->pos + dev->dir * done(dev) : dev->pos;
+	taskEXIT_CRITICAL();
+	return (p);
+}
+
+/**
+ * stepper_set_pos
+ */
+void stepper_set_pos(stepper dev, int pos)
+{
+	if (dev->busy) {
+		crit_err_exit(UNEXP_PROG_STATE);
+	}
+	dev->pos = pos;
+}
+
+/**
+ * stepper_busy
+ */
+boolean_t stepper_busy(stepper dev)
+{
+	return (dev->busy);
+}
+
+/**
+ * stepper_enable
+ */
+void stepper_enable(stepper dev, boolean_t en)
+{
+	if (dev->en_port) {
+		set_pin_lev(dev->en_pin, dev->en_port, (en) ? dev->en_act_lev : !dev->en_act_lev);
+	}
+}
+
+/**
+ * build
+ */
+static void build(stepper dev, int n)
+{
+	int a, d, c, i = 0, sz;
+
+	a = (n / 2 < dev->ramp_len) ? n / 2 : dev->ramp_len;
+	d = (n - a < dev->ramp_len) ? n - a : dev->ramp_len;
+	c = n - a - d;
+	if (c > STEPPER_CRUISE_DESC * 0xFFFF) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	dev->acc_n = a;
+	dev->seg = 0;
+	dev->seg_start[0] = 0;
+	if (a) {
+		conf_desc(dev, i++, dev->acc, a, TRUE);
+	}
+	while (c) {
+		sz = (c > 0xFFFF) ? 0xFFFF : c;
+		conf_desc(dev, i++, &dev->cruise, sz, FALSE);
+		c -= sz;
+	}
+	conf_desc(dev, i++, dev->dec + dev->ramp_len - d, d, TRUE);
+	dev->nseg = i;
+}
+
+/**
+ * conf_desc
+ */
+static void conf_desc(stepper dev, int i, const uint16_t *src, int size, boolean_t inc)
+{
+	DmacDescriptor *desc = (i) ? &dev->desc[i - 1] : dev->channel->trans_desc;
+
+	// Interrupt after every segment keeps position counter.
+	desc->BTCTRL.reg = DMAC_BTCTRL_BEATSIZE_HWORD | DMAC_BTCTRL_BLOCKACT_INT | DMAC_BTCTRL_VALID |
+	                   ((inc) ? DMAC_BTCTRL_SRCINC : 0);
+	desc->BTCNT.reg = size;
+	desc->SRCADDR.reg = (unsigned int) ((inc) ? src + size : src);
+	desc->DSTADDR.reg = (unsigned int) &dev->tc.mmio->COUNT16.CC[0].reg;
+	desc->DESCADDR.reg = 0;
+	if (i) {
+		((i > 1) ? &dev->desc[i - 2] : dev->channel->trans_desc)->DESCADDR.reg = (unsigned int) desc;
+	}
+	dev->seg_len[i] = size;
+	dev->seg_start[i + 1] = dev->seg_start[i] + size;
+}
+
+/**
+ * done
+ */
+static int done(stepper dev)
+{
+	boolean_t cmpl;
+	int rem, s;
+
+	// Write-back BTCNT belongs to segment dev->seg or, if its completion is
+	// not yet handled, to the next one (0 before next descriptor is fetched).
+	rem = dmac_channel_remain(dev->channel, &cmpl);
+	s = dev->seg + cmpl;
+	if (s >= dev->nseg || !rem) {
+		return (dev->seg_start[(s < dev->nseg) ? s : dev->nseg]);
+	}
+	return (dev->seg_start[s] + dev->seg_len[s] - rem);
+}
+
+/**
+ * decel
+ *
+ * Replace rest of move by deceleration from current speed (called from TC
+ * ISR at step boundary).
+ */
+static void decel(stepper dev)
+{
+	int n, k;
+
+	if (dev->seg >= dev->nseg - 1) {
+		// Already decelerating.
+		return;
+	}
+	n = done(dev);
+	k = (n < dev->acc_n) ? n : dev->acc_n;
+	if (!k || dev->seg_start[dev->nseg] - n <= k) {
+		return;
+	}
+	dmac_channel_abort_isr(dev->channel);
+	dev->pos += dev->dir * n;
+	dev->seg = 0;
+	dev->nseg = 1;
+	dev->seg_start[0] = 0;
+	conf_desc(dev, 0, dev->dec + dev->ramp_len - k, k, TRUE);
+	enable_dmac_transfer_isr(dev->channel);
+	dev->stop_cnt++;
+}
+
+/**
+ * dma_hndlr
+ */
+static BaseType_t dma_hndlr(void *dev, enum dmac_intr intr)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	stepper d = dev;
+	uint8_t er = 1;
+
+	if (intr != DMAC_TCMPL_INTR) {
+		disable_dmac_channel_intr(d->channel);
+		tc_stop(&d->tc);
+		tc_disable_ovf_intr(&d->tc);
+		d->stop_req = FALSE;
+		d->pos += d->dir * d->seg_start[d->seg];
+		d->seg = d->nseg;
+		d->busy = FALSE;
+		d->err_cnt++;
+		xQueueSendFromISR(d->sig_que, &er, &tsk_wkn);
+		return (tsk_wkn);
+	}
+	if (++d->seg < d->nseg) {
+		clear_dmac_channel_intr(d->channel);
+		return (pdFALSE);
+	}
+	// Last period is running, counter stops at its end.
+	disable_dmac_channel_intr(d->channel);
+	d->pos += d->dir * d->seg_start[d->nseg];
+	d->tc.mmio->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+	tc_clear_ovf_intr(&d->tc);
+	tc_enable_ovf_intr(&d->tc);
+	return (pdFALSE);
+}
+
+/**
+ * tc_isr_clbk
+ */
+static BaseType_t tc_isr_clbk(void *dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	stepper d = TC_OWNER(dev, struct stepper_dsc);
+	uint8_t er = 0;
+
+	tc_disable_ovf_intr(&d->tc);
+	tc_clear_ovf_intr(&d->tc);
+	d->stop_req = FALSE;
+	if (d->seg < d->nseg) {
+		// Step boundary requested by stepper_stop().
+		decel(d);
+		return (pdFALSE);
+	}
+	d->busy = FALSE;
+	xQueueSendFromISR(d->sig_que, &er, &tsk_wkn);
+	return (tsk_wkn);
+}
+
+#if TERMOUT == 1
+/**
+ * log_stepper_stats
+ */
+void log_stepper_stats(stepper dev)
+{
+	msg(INF, "stepper.c: tc=%d tick=%u ramp=%d pos=%d move=%u stop=%u err=%u\n", dev->tc.id,
+	    dev->tick_freq, dev->ramp_len, stepper_pos(dev), dev->move_cnt, dev->stop_cnt, dev->err_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * stepper.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#ifndef STEPPER
+ #define STEPPER 0
+#endif
+
+#if STEPPER == 1
+
+#ifndef STEPPER_CRUISE_DESC
+ #define STEPPER_CRUISE_DESC 4
+#endif
+
+#include "tc.h"
+#include "dmac.h"
+
+#define STEPPER_SEGS (STEPPER_CRUISE_DESC + 2)
+
+enum stepper_ramp {
+	STEPPER_RAMP_TRAPEZ,
+	STEPPER_RAMP_SCURVE
+};
+
+typedef struct stepper_dsc *stepper;
+
+struct stepper_dsc {
+	DmacDescriptor desc[STEPPER_SEGS - 1] __attribute__((aligned(16))); // Linked descriptors (static instances).
+	struct tc_timer_dsc tc; // <SetIt> - tc.id, tc.clk_gen, tc.clock_freq.
+	int pulse_us; // <SetIt> - STEP pulse width [us].
+	boolean_t inv; // <SetIt> - Invert STEP (WO[1]) output.
+	void (*conf_pins)(enum tc_conf_pins_cmd); // <SetIt> - STEP (WO[1]) pin configuration.
+	PortGroup *dir_port; // <SetIt>
+	int dir_pin; // <SetIt>
+	boolean_t dir_inv; // <SetIt> - DIR level HIGH for positive direction.
+	PortGroup *en_port; // <SetIt> - NULL if ENABLE pin not used.
+	int en_pin; // <SetIt>
+	boolean_t en_act_lev; // <SetIt> - ENABLE active level (HIGH, LOW).
+	enum stepper_ramp ramp; // <SetIt>
+	int v_min; // <SetIt> - Start/stop speed [steps/s].
+	int v_max; // <SetIt> - Cruise speed [steps/s].
+	int accel; // <SetIt> - Acceleration (S-curve peak acceleration) [steps/s^2].
+	int ramp_max; // <SetIt> - Ramp table capacity [steps].
+	dmac_channel channel;
+	QueueHandle_t sig_que;
+	unsigned int tick_freq;
+	unsigned int pulse;
+	uint16_t *acc;
+	uint16_t *dec;
+	int ramp_len;
+	uint16_t cruise;
+	int acc_n;
+	int dir;
+	int pos;
+	int seg;
+	int nseg;
+	int seg_len[STEPPER_SEGS];
+	int seg_start[STEPPER_SEGS + 1];
+	boolean_t busy;
+	boolean_t stop_req;
+	unsigned int move_cnt;
+	unsigned int stop_cnt;
+	unsigned int err_cnt;
+};
+
+/**
+ * init_stepper
+ *
+ * Configure TC instance as 16-bit PWM generating STEP pulses (step period
+ * in CC0, pulse width in CC1 driving WO[1]), DIR and ENABLE pins and DMAC
+ * channel which writes next step period on every counter overflow. Ramp
+ * tables are computed by stepper_profile().
+ *
+ * @dev: Stepper instance.
+ */
+void init_stepper(stepper dev);
+
+/**
+ * stepper_profile
+ *
+ * Compute acceleration and deceleration tables from dev->ramp, dev->v_min,
+ * dev->v_max and dev->accel. Table has one period per step, ramp is
+ * truncated to dev->ramp_max steps. Motor must be stopped.
+ *
+ * @dev: Stepper instance.
+ */
+void stepper_profile(stepper dev);
+
+/**
+ * stepper_move
+ *
+ * Start relative move. Steps are generated by TC and DMAC only, no CPU time
+ * is used except one DMAC interrupt per profile segment. Move is accelerated
+ * from v_min, cruises at v_max and is decelerated to v_min (short moves
+ * reach only fraction of v_max). Maximal cruise part is
+ * STEPPER_CRUISE_DESC * 65535 steps.
+ *
+ * @dev: Stepper instance.
+ * @steps: Number of steps (sign gives direction).
+ */
+void stepper_move(stepper dev, int steps);
+
+/**
+ * stepper_wait
+ *
+ * Wait for end of move.
+ *
+ * @dev: Stepper instance.
+ * @tmo: Timeout [ticks].
+ *
+ * Returns: 0 - success; -ETMO - timeout; -EDMA - dma error.
+ */
+int stepper_wait(stepper dev, TickType_t tmo);
+
+/**
+ * stepper_stop
+ *
+ * Stop move with deceleration from current speed. Deceleration is started
+ * by TC ISR at next step boundary (counter overflow). Function returns
+ * immediately, end of move is signaled to stepper_wait().
+ *
+ * @dev: Stepper instance.
+ */
+void stepper_stop(stepper dev);
+
+/**
+ * stepper_pos
+ *
+ * Returns: Position (steps issued, updated while moving).
+ */
+int stepper_pos(stepper dev);
+
+/**
+ * stepper_set_pos
+ *
+ * Set position counter. Motor must be stopped.
+ */
+void stepper_set_pos(stepper dev, int pos);
+
+/**
+ * stepper_busy
+ *
+ * Returns: TRUE - motor is moving; FALSE - motor is stopped.
+ */
+boolean_t stepper_busy(stepper dev);
+
+/**
+ * stepper_enable
+ *
+ * Set ENABLE pin of driver.
+ *
+ * @dev: Stepper instance.
+ * @en: TRUE - driver enabled; FALSE - driver disabled.
+ */
+void stepper_enable(stepper dev, boolean_t en);
+
+#if TERMOUT == 1
+/**
+ * log_stepper_stats
+ */
+void log_stepper_stats(stepper dev);
+#endif
+#endif
+
+#endif
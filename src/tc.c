@@ -34,6 +34,10 @@
 
 #if TC_TIMER == 1
 
+#define BENCH_LOOPS 16
+
+static const short presc_div[] = {1, 2, 4, 8, 16, 64, 256, 1024};
+
 extern inline void tc_enable_mc0_intr(tc_timer dev);
 extern inline void tc_enable_mc1_intr(tc_timer dev);
 extern inline void tc_enable_err_intr(tc_timer dev);
@@ -47,8 +51,16 @@ extern inline void tc_clear_mc1_intr(tc_timer dev);
 extern inline void tc_clear_err_intr(tc_timer dev);
 extern inline void tc_clear_ovf_intr(tc_timer dev);
 extern inline void tc_disable_all_intr(tc_timer dev);
+extern inline void tc_enable_syncrdy_intr(tc_timer dev);
+extern inline void tc_disable_syncrdy_intr(tc_timer dev);
+extern inline void tc_clear_syncrdy_intr(tc_timer dev);
 
 static inline boolean_t sync(tc_timer dev);
+static void set_rcont(tc_timer dev, boolean_t rcont);
+static void write_dfr(tc_timer dev);
+#if TERMOUT == 1
+static int bench(tc_timer dev, int op);
+#endif
 
 /**
  * init_tc
@@ -132,6 +144,7 @@ void init_tc(tc_timer dev)
                          TC_CTRLA_MODE(dev->cnt_size);
 	dev->reg_ctrlc = ((dev->chan_1_capt) ? TC_CTRLC_CPTEN1 : 0) | ((dev->chan_0_capt) ? TC_CTRLC_CPTEN0 : 0) |
 			  ((dev->chan_1_wave_inv) ? TC_CTRLC_INVEN1 : 0) | ((dev->chan_0_wave_inv) ? TC_CTRLC_INVEN0 : 0);
+	dev->dfr_msk = 0;
 	NVIC_DisableIRQ(dev->irqn);
         enable_clk_channel(dev->clk_chn, dev->clk_gen);
         enable_per_apb_clk(dev->apb_bus_ins, dev->apb_mask);
@@ -151,7 +164,9 @@ void init_tc(tc_timer dev)
 		dev->mmio->COUNT16.CTRLBSET.reg = bset;
                 while (!sync(dev));
 	}
-	dev->mmio->COUNT16.EVCTRL.reg = TC_EVCTRL_EVACT(dev->capmode);
+	dev->mmio->COUNT16.EVCTRL.reg = TC_EVCTRL_EVACT(dev->capmode) |
+	                                ((dev->ev_input) ? TC_EVCTRL_TCEI : 0) |
+	                                ((dev->ev_inv) ? TC_EVCTRL_TCINV : 0);
 	if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
 		dev->mmio->COUNT32.CC[0].reg = dev->cc0;
 		dev->mmio->COUNT32.CC[1].reg = dev->cc1;
@@ -171,6 +186,9 @@ void init_tc(tc_timer dev)
 	}
 	dev->mmio->COUNT16.CTRLA.reg = dev->reg_ctrla | TC_CTRLA_ENABLE;
 	while (!sync(dev));
+	if (dev->cnt_rcont) {
+		set_rcont(dev, TRUE);
+	}
 }
 
 /**
@@ -257,6 +275,19 @@ void tc_set_direction(tc_timer dev, enum tc_direction dir)
         while (!sync(dev));
 }
 
+/**
+ * tc_set_oneshot
+ */
+void tc_set_oneshot(tc_timer dev, boolean_t oneshot)
+{
+	if (oneshot) {
+		dev->mmio->COUNT16.CTRLBSET.reg = TC_CTRLBSET_ONESHOT;
+	} else {
+		dev->mmio->COUNT16.CTRLBCLR.reg = TC_CTRLBCLR_ONESHOT;
+	}
+        while (!sync(dev));
+}
+
 /**
  * tc_set_cc0
  */
@@ -296,6 +327,267 @@ void tc_set_cnt(tc_timer dev, unsigned int v)
         while (!sync(dev));
 }
 
+/**
+ * tc_post_cc0
+ */
+void tc_post_cc0(tc_timer dev, unsigned int v)
+{
+	while (!sync(dev));
+	if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
+		dev->mmio->COUNT32.CC[0].reg = v;
+	} else {
+		dev->mmio->COUNT16.CC[0].reg = v;
+	}
+}
+
+/**
+ * tc_post_cc1
+ */
+void tc_post_cc1(tc_timer dev, unsigned int v)
+{
+	while (!sync(dev));
+	if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
+		dev->mmio->COUNT32.CC[1].reg = v;
+	} else {
+		dev->mmio->COUNT16.CC[1].reg = v;
+	}
+}
+
+/**
+ * tc_post_cc
+ */
+void tc_post_cc(tc_timer dev, unsigned int cc0, unsigned int cc1)
+{
+	while (!sync(dev));
+	if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
+		dev->mmio->COUNT32.CC[0].reg = cc0;
+		dev->mmio->COUNT32.CC[1].reg = cc1;
+	} else {
+		dev->mmio->COUNT16.CC[0].reg = cc0;
+		dev->mmio->COUNT16.CC[1].reg = cc1;
+	}
+}
+
+/**
+ * tc_defer_cc
+ */
+void tc_defer_cc(tc_timer dev, unsigned int cc0, unsigned int cc1)
+{
+	UBaseType_t m;
+
+	m = taskENTER_CRITICAL_FROM_ISR();
+	dev->dfr_cc[0] = cc0;
+	dev->dfr_cc[1] = cc1;
+	dev->dfr_msk = 0x3;
+	dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_SYNCRDY;
+	if (sync(dev)) {
+		write_dfr(dev);
+	}
+	dev->mmio->COUNT16.INTENSET.reg = TC_INTENSET_SYNCRDY;
+	taskEXIT_CRITICAL_FROM_ISR(m);
+}
+
+/**
+ * tc_syncrdy_isr
+ */
+boolean_t tc_syncrdy_isr(tc_timer dev)
+{
+	dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_SYNCRDY;
+	write_dfr(dev);
+	if (!dev->dfr_msk) {
+		dev->mmio->COUNT16.INTENCLR.reg = TC_INTENCLR_SYNCRDY;
+		return (TRUE);
+	}
+	return (FALSE);
+}
+
+/**
+ * tc_sync
+ */
+void tc_sync(tc_timer dev)
+{
+	while (!sync(dev));
+}
+
+/**
+ * tc_get_cnt
+ */
+unsigned int tc_get_cnt(tc_timer dev)
+{
+	if (!dev->cnt_rcont) {
+		dev->mmio->COUNT16.READREQ.reg = TC_READREQ_RREQ | TC_READREQ_ADDR(TC_COUNT16_COUNT_OFFSET);
+		while (!sync(dev));
+	}
+	if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
+		return (dev->mmio->COUNT32.COUNT.reg);
+	} else if (dev->cnt_size == TC_CNT_SIZE_8_BIT) {
+		return (dev->mmio->COUNT8.COUNT.reg);
+	} else {
+		return (dev->mmio->COUNT16.COUNT.reg);
+	}
+}
+
+/**
+ * tc_dmac_trg_num
+ */
+int tc_dmac_trg_num(tc_timer dev, enum tc_dmac_trg trg)
+{
+	int n;
+
+	switch (dev->id) {
+	case ID_TC3 :
+		n = TC3_DMAC_ID_OVF;
+		break;
+	case ID_TC4 :
+		n = TC4_DMAC_ID_OVF;
+		break;
+	case ID_TC5 :
+		n = TC5_DMAC_ID_OVF;
+		break;
+#ifdef TC6
+	case ID_TC6 :
+		n = TC6_DMAC_ID_OVF;
+		break;
+#endif
+#ifdef TC7
+	case ID_TC7 :
+		n = TC7_DMAC_ID_OVF;
+		break;
+#endif
+	default :
+		crit_err_exit(BAD_PARAMETER);
+		return (0);
+	}
+	return (n + trg);
+}
+
+/**
+ * tc_fit_prescaler
+ */
+int tc_fit_prescaler(unsigned int clock_freq, unsigned int num, unsigned int den, unsigned int *ticks)
+{
+	unsigned long long t = 0;
+	int i;
+
+	for (i = 0; i < (int) (sizeof(presc_div) / sizeof(presc_div[0])); i++) {
+		t = (unsigned long long) clock_freq / presc_div[i] * num / den;
+		if (t <= 0x10000) {
+			break;
+		}
+	}
+	if (t > 0x10000) {
+		return (-1);
+	}
+	*ticks = t;
+	return (i);
+}
+
+/**
+ * tc_tick_freq
+ */
+unsigned int tc_tick_freq(tc_timer dev)
+{
+	return (dev->clock_freq / presc_div[dev->prescaler]);
+}
+
+/**
+ * set_rcont
+ */
+static void set_rcont(tc_timer dev, boolean_t rcont)
+{
+	dev->mmio->COUNT16.READREQ.reg = TC_READREQ_RREQ | ((rcont) ? TC_READREQ_RCONT : 0) |
+	                                 TC_READREQ_ADDR(TC_COUNT16_COUNT_OFFSET);
+	while (!sync(dev));
+}
+
+#if TERMOUT == 1
+/**
+ * log_tc_bench
+ */
+void log_tc_bench(tc_timer dev)
+{
+	boolean_t rcont = dev->cnt_rcont;
+	int c[6];
+
+	for (int i = 0; i < 4; i++) {
+		c[i] = bench(dev, i);
+	}
+	set_rcont(dev, FALSE);
+	dev->cnt_rcont = FALSE;
+	c[4] = bench(dev, 4);
+	set_rcont(dev, TRUE);
+	dev->cnt_rcont = TRUE;
+	c[5] = bench(dev, 4);
+	set_rcont(dev, rcont);
+	dev->cnt_rcont = rcont;
+	msg(INF, "tc.c: cycles set_cc0=%d post_cc0=%d post_cc0_busy=%d post_cc=%d get_cnt=%d get_cnt_rcont=%d\n",
+	    c[0], c[1], c[2], c[3], c[4], c[5]);
+}
+
+/**
+ * bench
+ *
+ * Returns: Average number of CPU cycles of operation.
+ */
+static int bench(tc_timer dev, int op)
+{
+	unsigned int t0, t1, load = SysTick->LOAD + 1, sum = 0;
+	volatile unsigned int v = 0;
+
+	for (int i = 0; i < BENCH_LOOPS; i++) {
+		while (!sync(dev));
+		taskENTER_CRITICAL();
+		if (op == 2) {
+			// Previous write still synchronized.
+			tc_post_cc0(dev, dev->cc0);
+		}
+		t0 = SysTick->VAL;
+		switch (op) {
+		case 0 :
+			tc_set_cc0(dev, dev->cc0);
+			break;
+		case 1 :
+		case 2 :
+			tc_post_cc0(dev, dev->cc0);
+			break;
+		case 3 :
+			tc_post_cc(dev, dev->cc0, dev->cc1);
+			break;
+		default :
+			v = tc_get_cnt(dev);
+			break;
+		}
+		t1 = SysTick->VAL;
+		taskEXIT_CRITICAL();
+		sum += (t0 - t1 + load) % load;
+	}
+	(void) v;
+	return (sum / BENCH_LOOPS);
+}
+#endif
+
+/**
+ * write_dfr
+ */
+static void write_dfr(tc_timer dev)
+{
+	if (dev->dfr_msk & 0x1) {
+		dev->dfr_msk &= ~0x1;
+		if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
+			dev->mmio->COUNT32.CC[0].reg = dev->dfr_cc[0];
+		} else {
+			dev->mmio->COUNT16.CC[0].reg = dev->dfr_cc[0];
+		}
+	} else if (dev->dfr_msk & 0x2) {
+		dev->dfr_msk &= ~0x2;
+		if (dev->cnt_size == TC_CNT_SIZE_32_BIT) {
+			dev->mmio->COUNT32.CC[1].reg = dev->dfr_cc[1];
+		} else {
+			dev->mmio->COUNT16.CC[1].reg = dev->dfr_cc[1];
+		}
+	}
+}
+
 /**
  * sync
  */
@@ -25,6 +25,7 @@
 
 #if TC_TIMER == 1
 
+#include <stddef.h>
 #include "pm.h"
 
 enum tc_cnt_size {
@@ -68,6 +69,12 @@ enum capture_mode {
         CAPTURE_MODE_PWP = 6
 };
 
+enum tc_dmac_trg {
+	TC_DMAC_TRG_OVF,
+	TC_DMAC_TRG_MC0,
+        TC_DMAC_TRG_MC1
+};
+
 enum tc_conf_pins_cmd {
 	TC_CONF_PINS,
 	TC_PINS_TO_PORT
@@ -92,10 +99,13 @@ struct tc_timer_dsc {
 	boolean_t chan_0_wave_inv; // <SetIt>
 	boolean_t chan_1_wave_inv; // <SetIt>
         enum capture_mode capmode; // <SetIt>
+	boolean_t ev_input; // <SetIt> - Event input enable (capture or counter event action).
+	boolean_t ev_inv; // <SetIt> - Invert event input.
 	uint8_t int_enable_mask; // <SetIt>
         BaseType_t (*isr_clbk)(void *); // <SetIt>
 	void (*conf_pins)(enum tc_conf_pins_cmd); // <SetIt> - NULL if io pins not used.
 	boolean_t runstdby; // <SetIt>
+	boolean_t cnt_rcont; // <SetIt> - Continuous COUNT read synchronization (tc_get_cnt() without wait).
         Tc *mmio;
         enum apb_bus_ins apb_bus_ins;
 	unsigned int apb_mask;
@@ -105,6 +115,8 @@ struct tc_timer_dsc {
         int clk_chn;
         unsigned short reg_ctrla;
         unsigned short reg_ctrlc;
+        volatile unsigned int dfr_msk;
+        unsigned int dfr_cc[2];
 };
 
 /**
@@ -163,6 +175,13 @@ void tc_stop(tc_timer dev);
  */
 void tc_set_direction(tc_timer dev, enum tc_direction dir);
 
+/**
+ * tc_set_oneshot
+ *
+ * Enable (counter stops on next overflow) or disable one-shot mode.
+ */
+void tc_set_oneshot(tc_timer dev, boolean_t oneshot);
+
 /**
  * tc_set_cc0
  *
@@ -184,6 +203,108 @@ void tc_set_cc1(tc_timer dev, unsigned int v);
  */
 void tc_set_cnt(tc_timer dev, unsigned int v);
 
+/**
+ * tc_post_cc0
+ *
+ * Set CC0 register without waiting for synchronization end. Caller waits
+ * only if previous write is still synchronized.
+ */
+void tc_post_cc0(tc_timer dev, unsigned int v);
+
+/**
+ * tc_post_cc1
+ *
+ * Set CC1 register without waiting for synchronization end.
+ */
+void tc_post_cc1(tc_timer dev, unsigned int v);
+
+/**
+ * tc_post_cc
+ *
+ * Set CC0 and CC1 registers (batched update) without waiting for
+ * synchronization end. TC has no compare buffer registers, second write
+ * is stalled on bus until first one is synchronized.
+ */
+void tc_post_cc(tc_timer dev, unsigned int cc0, unsigned int cc1);
+
+/**
+ * tc_defer_cc
+ *
+ * Set CC0 and CC1 registers without stalling on bus. CC0 is written at once
+ * if TC is not synchronizing, remaining writes are deferred to SYNCRDY
+ * interrupt. TC ISR callback (dev->isr_clbk) must call tc_syncrdy_isr() when
+ * SYNCRDY flag is set. Can be called from ISR.
+ */
+void tc_defer_cc(tc_timer dev, unsigned int cc0, unsigned int cc1);
+
+/**
+ * tc_syncrdy_isr
+ *
+ * Write next deferred CC register. Called from TC ISR callback on SYNCRDY
+ * interrupt, SYNCRDY interrupt is disabled after last deferred write.
+ *
+ * Returns: TRUE - all deferred writes done, FALSE - write pending.
+ */
+boolean_t tc_syncrdy_isr(tc_timer dev);
+
+/**
+ * tc_sync
+ *
+ * Wait for end of posted writes synchronization. Instead of waiting, writes
+ * can be completed on SYNCRDY interrupt (tc_defer_cc()).
+ */
+void tc_sync(tc_timer dev);
+
+/**
+ * tc_get_cnt
+ *
+ * Get counter value. Read is synchronized on request unless dev->cnt_rcont
+ * is set.
+ */
+unsigned int tc_get_cnt(tc_timer dev);
+
+/**
+ * tc_dmac_trg_num
+ *
+ * Get DMAC trigger source number of TC event.
+ *
+ * @dev: TC instance.
+ * @trg: Event (overflow, match/capture 0/1).
+ *
+ * Returns: DMAC trigger source number.
+ */
+int tc_dmac_trg_num(tc_timer dev, enum tc_dmac_trg trg);
+
+/**
+ * tc_fit_prescaler
+ *
+ * Find lowest prescaler for which period of num / den seconds fits into
+ * 16-bit counter (finest resolution).
+ *
+ * @clock_freq: GCLK frequency.
+ * @num: Period numerator [s].
+ * @den: Period denominator.
+ * @ticks: Period in prescaled clock ticks (1 - 65536).
+ *
+ * Returns: Prescaler (enum tc_prescaler); -1 - period too long.
+ */
+int tc_fit_prescaler(unsigned int clock_freq, unsigned int num, unsigned int den, unsigned int *ticks);
+
+/**
+ * tc_tick_freq
+ *
+ * Returns: Counter clock frequency after prescaler [Hz].
+ */
+unsigned int tc_tick_freq(tc_timer dev);
+
+/**
+ * TC_OWNER
+ *
+ * Get driver instance embedding TC instance as member tc (TC ISR callback
+ * argument).
+ */
+#define TC_OWNER(dev, type) ((type *) ((char *) (dev) - offsetof(type, tc)))
+
 /**
  * tc_enable_mc0_intr
  */
@@ -216,6 +337,14 @@ inline void tc_enable_ovf_intr(tc_timer dev)
 	dev->mmio->COUNT16.INTENSET.reg = TC_INTENSET_OVF;
 }
 
+/**
+ * tc_enable_syncrdy_intr
+ */
+inline void tc_enable_syncrdy_intr(tc_timer dev)
+{
+	dev->mmio->COUNT16.INTENSET.reg = TC_INTENSET_SYNCRDY;
+}
+
 /**
  * tc_disable_mc0_intr
  */
@@ -252,6 +381,15 @@ inline void tc_disable_ovf_intr(tc_timer dev)
         dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
 }
 
+/**
+ * tc_disable_syncrdy_intr
+ */
+inline void tc_disable_syncrdy_intr(tc_timer dev)
+{
+	dev->mmio->COUNT16.INTENCLR.reg = TC_INTENCLR_SYNCRDY;
+        dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_SYNCRDY;
+}
+
 /**
  * tc_clear_mc0_intr
  */
@@ -284,14 +422,38 @@ inline void tc_clear_ovf_intr(tc_timer dev)
         dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_OVF;
 }
 
+/**
+ * tc_clear_syncrdy_intr
+ */
+inline void tc_clear_syncrdy_intr(tc_timer dev)
+{
+        dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_SYNCRDY;
+}
+
 /**
  * tc_disable_all_intr
  */
 inline void tc_disable_all_intr(tc_timer dev)
 {
-	dev->mmio->COUNT16.INTENCLR.reg = TC_INTENCLR_MC0 | TC_INTENCLR_MC1 | TC_INTENCLR_ERR | TC_INTENCLR_OVF;
-        dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0 | TC_INTFLAG_MC1 | TC_INTFLAG_ERR | TC_INTFLAG_OVF;
+	dev->mmio->COUNT16.INTENCLR.reg = TC_INTENCLR_MC0 | TC_INTENCLR_MC1 | TC_INTENCLR_ERR | TC_INTENCLR_OVF |
+	                                  TC_INTENCLR_SYNCRDY;
+        dev->mmio->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0 | TC_INTFLAG_MC1 | TC_INTFLAG_ERR | TC_INTFLAG_OVF |
+	                                 TC_INTFLAG_SYNCRDY;
 }
+
+#if TERMOUT == 1
+/**
+ * log_tc_bench
+ *
+ * Measure CPU cycles (SysTick) per register access: synchronized write
+ * (tc_set_cc0), posted write (tc_post_cc0), batched write (tc_post_cc) and
+ * counter read with and without continuous read synchronization. Compare
+ * registers are overwritten by dev->cc0 and dev->cc1 values.
+ *
+ * @dev: TC instance.
+ */
+void log_tc_bench(tc_timer dev);
+#endif
 #endif
 
 #endif
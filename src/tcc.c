@@ -0,0 +1,265 @@
+/*
+ * tcc.c
+ *
+ * Copyright (c) 2021 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "tcisr.h"
+#include "tcc.h"
+
+#if TCC_TIMER == 1
+
+extern inline void tcc_enable_intr(tcc_timer dev, unsigned int mask);
+extern inline void tcc_disable_intr(tcc_timer dev, unsigned int mask);
+extern inline void tcc_clear_intr(tcc_timer dev, unsigned int mask);
+
+static unsigned int fctrl(struct tcc_rfault_cfg *f);
+static inline void sync(tcc_timer dev, unsigned int mask);
+
+/**
+ * init_tcc
+ */
+void init_tcc(tcc_timer dev)
+{
+	switch (dev->id) {
+	case ID_TCC0 :
+		dev->mmio = TCC0;
+                dev->irqn = TCC0_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_TCC0;
+                dev->clk_chn = GCLK_CLKCTRL_ID_TCC0_TCC1_Val;
+		dev->cc_num = TCC0_CC_NUM;
+		dev->size = TCC0_SIZE;
+		break;
+	case ID_TCC1 :
+		dev->mmio = TCC1;
+                dev->irqn = TCC1_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_TCC1;
+                dev->clk_chn = GCLK_CLKCTRL_ID_TCC0_TCC1_Val;
+		dev->cc_num = TCC1_CC_NUM;
+		dev->size = TCC1_SIZE;
+		break;
+	case ID_TCC2 :
+		dev->mmio = TCC2;
+                dev->irqn = TCC2_IRQn;
+                dev->apb_bus_ins = APB_BUS_INST_C;
+                dev->apb_mask = PM_APBCMASK_TCC2;
+                dev->clk_chn = GCLK_CLKCTRL_ID_TCC2_TC3_Val;
+		dev->cc_num = TCC2_CC_NUM;
+		dev->size = TCC2_SIZE;
+		break;
+	default      :
+		crit_err_exit(BAD_PARAMETER);
+		break;
+	}
+	if (dev->resolution != TCC_RESOLUTION_NONE && dev->id == ID_TCC2) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if ((dev->otmx || dev->dti_mask) && dev->id != ID_TCC0) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (dev->patt_en && dev->id == ID_TCC2) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (dev->circ_cc_mask >> dev->cc_num || dev->dti_mask >> dev->cc_num) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	NVIC_DisableIRQ(dev->irqn);
+        enable_clk_channel(dev->clk_chn, dev->clk_gen);
+        enable_per_apb_clk(dev->apb_bus_ins, dev->apb_mask);
+        reg_tc_isr_clbk(dev->id, dev->isr_clbk, dev);
+	dev->mmio->CTRLA.reg = TCC_CTRLA_SWRST;
+	while (dev->mmio->SYNCBUSY.reg & TCC_SYNCBUSY_SWRST);
+	dev->mmio->CTRLA.reg = TCC_CTRLA_RESOLUTION(dev->resolution) | TCC_CTRLA_PRESCALER(dev->prescaler) |
+	                       TCC_CTRLA_PRESCSYNC_PRESC | ((dev->runstdby) ? TCC_CTRLA_RUNSTDBY : 0);
+	dev->mmio->WAVE.reg = TCC_WAVE_WAVEGEN(dev->wavegen) | TCC_WAVE_POL(dev->pol_mask) |
+	                      ((dev->circ_per) ? TCC_WAVE_CIPEREN : 0) | TCC_WAVE_CICCEN(dev->circ_cc_mask);
+	sync(dev, TCC_SYNCBUSY_WAVE);
+	if (dev->id == ID_TCC0) {
+		dev->mmio->WEXCTRL.reg = TCC_WEXCTRL_OTMX(dev->otmx) | TCC_WEXCTRL_DTIEN(dev->dti_mask) |
+		                         TCC_WEXCTRL_DTLS(dev->dt_ls) | TCC_WEXCTRL_DTHS(dev->dt_hs);
+	}
+	dev->mmio->DRVCTRL.reg = TCC_DRVCTRL_NRE(dev->nre_mask) | TCC_DRVCTRL_NRV(dev->nrv_mask) |
+	                         TCC_DRVCTRL_INVEN(dev->inv_mask);
+	dev->mmio->FCTRLA.reg = fctrl(&dev->fault_a);
+	dev->mmio->FCTRLB.reg = fctrl(&dev->fault_b);
+	dev->mmio->EVCTRL.reg = ((dev->nfault_mask & 1) ? TCC_EVCTRL_EVACT0_FAULT : 0) |
+	                        ((dev->nfault_mask & 2) ? TCC_EVCTRL_EVACT1_FAULT : 0) |
+	                        TCC_EVCTRL_TCEI(dev->nfault_mask) | TCC_EVCTRL_TCINV(dev->nfault_inv) |
+	                        ((dev->fault_a.src != TCC_FAULT_SRC_DISABLE) ? TCC_EVCTRL_MCEI0 : 0) |
+	                        ((dev->fault_b.src != TCC_FAULT_SRC_DISABLE) ? TCC_EVCTRL_MCEI1 : 0);
+	dev->mmio->PER.reg = dev->per;
+	for (int i = 0; i < dev->cc_num; i++) {
+		dev->mmio->CC[i].reg = dev->cc[i];
+	}
+	if (dev->id != ID_TCC2) {
+		dev->mmio->PATT.reg = TCC_PATT_PGE(dev->patt_en) | TCC_PATT_PGV(dev->patt_val);
+	}
+	while (dev->mmio->SYNCBUSY.reg);
+        NVIC_SetPriority(dev->irqn, configLIBRARY_API_CALL_INTERRUPT_PRIORITY);
+        NVIC_ClearPendingIRQ(dev->irqn);
+	NVIC_EnableIRQ(dev->irqn);
+	if (dev->int_enable_mask) {
+		dev->mmio->INTENSET.reg = dev->int_enable_mask;
+	}
+	if (dev->conf_pins) {
+		dev->conf_pins(TCC_CONF_PINS);
+	}
+	dev->mmio->CTRLA.reg |= TCC_CTRLA_ENABLE;
+	sync(dev, TCC_SYNCBUSY_ENABLE);
+}
+
+/**
+ * tcc_trigger
+ */
+void tcc_trigger(tcc_timer dev)
+{
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+	dev->mmio->CTRLBSET.reg = TCC_CTRLBSET_CMD_RETRIGGER;
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+}
+
+/**
+ * tcc_stop
+ */
+void tcc_stop(tcc_timer dev)
+{
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+	dev->mmio->CTRLBSET.reg = TCC_CTRLBSET_CMD_STOP;
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+}
+
+/**
+ * tcc_set_per
+ */
+void tcc_set_per(tcc_timer dev, unsigned int v)
+{
+	sync(dev, TCC_SYNCBUSY_PERB);
+	dev->mmio->PERB.reg = v;
+}
+
+/**
+ * tcc_set_cc
+ */
+void tcc_set_cc(tcc_timer dev, int ch, unsigned int v)
+{
+	if (ch >= dev->cc_num) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	sync(dev, TCC_SYNCBUSY_CCB(1 << ch));
+	dev->mmio->CCB[ch].reg = v;
+}
+
+/**
+ * tcc_set_patt
+ */
+void tcc_set_patt(tcc_timer dev, uint8_t en, uint8_t val)
+{
+	if (dev->id == ID_TCC2) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	sync(dev, TCC_SYNCBUSY_PATTB);
+	dev->mmio->PATTB.reg = TCC_PATTB_PGEB(en) | TCC_PATTB_PGVB(val);
+}
+
+/**
+ * tcc_lock_update
+ */
+void tcc_lock_update(tcc_timer dev)
+{
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+	dev->mmio->CTRLBSET.reg = TCC_CTRLBSET_LUPD;
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+}
+
+/**
+ * tcc_unlock_update
+ */
+void tcc_unlock_update(tcc_timer dev)
+{
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+	dev->mmio->CTRLBCLR.reg = TCC_CTRLBCLR_LUPD;
+	sync(dev, TCC_SYNCBUSY_CTRLB);
+}
+
+/**
+ * tcc_fault_ev_user
+ */
+int tcc_fault_ev_user(tcc_timer dev, enum tcc_fault_in f)
+{
+	static const int8_t usr[][4] = {
+		{EVSYS_ID_USER_TCC0_MC_0, EVSYS_ID_USER_TCC0_MC_1, EVSYS_ID_USER_TCC0_EV_0, EVSYS_ID_USER_TCC0_EV_1},
+		{EVSYS_ID_USER_TCC1_MC_0, EVSYS_ID_USER_TCC1_MC_1, EVSYS_ID_USER_TCC1_EV_0, EVSYS_ID_USER_TCC1_EV_1},
+		{EVSYS_ID_USER_TCC2_MC_0, EVSYS_ID_USER_TCC2_MC_1, EVSYS_ID_USER_TCC2_EV_0, EVSYS_ID_USER_TCC2_EV_1}
+	};
+
+	return (usr[dev->id - ID_TCC0][f]);
+}
+
+/**
+ * tcc_fault_status
+ */
+unsigned int tcc_fault_status(tcc_timer dev)
+{
+	return (dev->mmio->STATUS.reg & (TCC_STATUS_FAULTA | TCC_STATUS_FAULTB | TCC_STATUS_FAULT0 |
+	                                 TCC_STATUS_FAULT1 | TCC_STATUS_FAULTAIN | TCC_STATUS_FAULTBIN |
+	                                 TCC_STATUS_FAULT0IN | TCC_STATUS_FAULT1IN));
+}
+
+/**
+ * tcc_fault_clear
+ */
+void tcc_fault_clear(tcc_timer dev, unsigned int mask)
+{
+	dev->mmio->STATUS.reg = mask & (TCC_STATUS_FAULTA | TCC_STATUS_FAULTB | TCC_STATUS_FAULT0 |
+	                                TCC_STATUS_FAULT1);
+	dev->mmio->INTFLAG.reg = ((mask & TCC_STATUS_FAULTA) ? TCC_INTFLAG_FAULTA : 0) |
+	                         ((mask & TCC_STATUS_FAULTB) ? TCC_INTFLAG_FAULTB : 0) |
+	                         ((mask & TCC_STATUS_FAULT0) ? TCC_INTFLAG_FAULT0 : 0) |
+	                         ((mask & TCC_STATUS_FAULT1) ? TCC_INTFLAG_FAULT1 : 0);
+}
+
+/**
+ * fctrl
+ */
+static unsigned int fctrl(struct tcc_rfault_cfg *f)
+{
+	if (f->src == TCC_FAULT_SRC_DISABLE) {
+		return (0);
+	}
+	return (TCC_FCTRLA_SRC(f->src) | TCC_FCTRLA_HALT(f->halt) | TCC_FCTRLA_BLANK(f->blank) |
+	        TCC_FCTRLA_BLANKVAL(f->blank_val) | TCC_FCTRLA_FILTERVAL(f->filter_val) |
+	        ((f->keep) ? TCC_FCTRLA_KEEP : 0) | ((f->qual) ? TCC_FCTRLA_QUAL : 0) |
+	        ((f->restart) ? TCC_FCTRLA_RESTART : 0));
+}
+
+/**
+ * sync
+ */
+static inline void sync(tcc_timer dev, unsigned int mask)
+{
+	while (dev->mmio->SYNCBUSY.reg & mask);
+}
+#endif
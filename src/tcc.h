@@ -0,0 +1,263 @@
+/*
+ * tcc.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TCC_H
+#define TCC_H
+
+#ifndef TCC_TIMER
+ #define TCC_TIMER 0
+#endif
+
+#if TCC_TIMER == 1
+
+#include "pm.h"
+
+enum tcc_prescaler {
+	TCC_PRESCALER_DIV1,
+	TCC_PRESCALER_DIV2,
+        TCC_PRESCALER_DIV4,
+        TCC_PRESCALER_DIV8,
+        TCC_PRESCALER_DIV16,
+        TCC_PRESCALER_DIV64,
+        TCC_PRESCALER_DIV256,
+        TCC_PRESCALER_DIV1024
+};
+
+enum tcc_resolution {
+	TCC_RESOLUTION_NONE,
+	TCC_RESOLUTION_DITH4,
+	TCC_RESOLUTION_DITH5,
+	TCC_RESOLUTION_DITH6
+};
+
+enum tcc_wavegen {
+	TCC_WAVEGEN_NFRQ,
+        TCC_WAVEGEN_MFRQ,
+        TCC_WAVEGEN_NPWM,
+        TCC_WAVEGEN_DSCRITICAL = 4,
+        TCC_WAVEGEN_DSBOTTOM,
+        TCC_WAVEGEN_DSBOTH,
+        TCC_WAVEGEN_DSTOP
+};
+
+enum tcc_fault_src {
+	TCC_FAULT_SRC_DISABLE,
+	TCC_FAULT_SRC_ENABLE,
+	TCC_FAULT_SRC_INVERT,
+	TCC_FAULT_SRC_ALTFAULT
+};
+
+enum tcc_fault_halt {
+	TCC_FAULT_HALT_DISABLE,
+	TCC_FAULT_HALT_HW,
+	TCC_FAULT_HALT_SW,
+	TCC_FAULT_HALT_NR
+};
+
+enum tcc_fault_blank {
+	TCC_FAULT_BLANK_START,
+	TCC_FAULT_BLANK_RISE,
+	TCC_FAULT_BLANK_FALL,
+	TCC_FAULT_BLANK_BOTH
+};
+
+enum tcc_fault_in {
+	TCC_FAULT_A, // Recoverable fault A (MC0 event input).
+	TCC_FAULT_B, // Recoverable fault B (MC1 event input).
+	TCC_FAULT_0, // Non-recoverable fault 0 (EV0 event input).
+	TCC_FAULT_1  // Non-recoverable fault 1 (EV1 event input).
+};
+
+enum tcc_conf_pins_cmd {
+	TCC_CONF_PINS,
+	TCC_PINS_TO_PORT
+};
+
+struct tcc_rfault_cfg {
+	enum tcc_fault_src src;
+	enum tcc_fault_halt halt;
+	boolean_t keep; // Output kept in fault state until end of period.
+	boolean_t qual; // Fault input is disabled when output is inactive.
+	boolean_t restart; // Restart counter on fault.
+	enum tcc_fault_blank blank;
+	uint8_t blank_val; // Blanking time [prescaled clock cycles].
+	uint8_t filter_val;
+};
+
+typedef struct tcc_timer_dsc *tcc_timer;
+
+struct tcc_timer_dsc {
+	int id; // <SetIt>
+	int clk_gen; // <SetIt> - GCLK instance for TCC clock channel.
+	int clock_freq; // <SetIt> - GCLK frequency.
+	enum tcc_prescaler prescaler; // <SetIt>
+	enum tcc_resolution resolution; // <SetIt> - Dithering (PER and CC in 1/16, 1/32, 1/64 cycles).
+	enum tcc_wavegen wavegen; // <SetIt>
+	unsigned int per; // <SetIt>
+	unsigned int cc[4]; // <SetIt>
+	uint8_t pol_mask; // <SetIt> - WAVE.POLx (channel output polarity).
+	uint8_t inv_mask; // <SetIt> - DRVCTRL.INVENx (WO[x] inversion).
+	boolean_t circ_per; // <SetIt> - PER/PERB circular buffer.
+	uint8_t circ_cc_mask; // <SetIt> - CCx/CCBx circular buffers.
+	uint8_t otmx; // <SetIt> - Output matrix (TCC0).
+	uint8_t dti_mask; // <SetIt> - Dead-time insertion of channels (TCC0, WO[x] and WO[x+4]).
+	uint8_t dt_ls; // <SetIt> - Low side dead-time [GCLK cycles].
+	uint8_t dt_hs; // <SetIt> - High side dead-time [GCLK cycles].
+	uint8_t patt_en; // <SetIt> - Pattern generator enabled outputs (TCC0, TCC1).
+	uint8_t patt_val; // <SetIt> - Pattern generator output values.
+	struct tcc_rfault_cfg fault_a; // <SetIt>
+	struct tcc_rfault_cfg fault_b; // <SetIt>
+	uint8_t nfault_mask; // <SetIt> - Non-recoverable fault inputs (bit 0 - EV0, bit 1 - EV1).
+	uint8_t nfault_inv; // <SetIt> - Non-recoverable fault inputs inversion.
+	uint8_t nre_mask; // <SetIt> - Outputs driven to nrv_mask level on non-recoverable fault.
+	uint8_t nrv_mask; // <SetIt>
+	unsigned int int_enable_mask; // <SetIt> - TCC_INTENSET_xxx.
+        BaseType_t (*isr_clbk)(void *); // <SetIt>
+	void (*conf_pins)(enum tcc_conf_pins_cmd); // <SetIt> - NULL if io pins not used.
+	boolean_t runstdby; // <SetIt>
+	Tcc *mmio;
+        enum apb_bus_ins apb_bus_ins;
+	unsigned int apb_mask;
+	IRQn_Type irqn;
+	int clk_chn;
+	int cc_num;
+	int size;
+};
+
+/**
+ * init_tcc
+ *
+ * Configure and enable TCC instance. Timer starts counting after
+ * initialization. Fault event inputs are connected to EVSYS by caller
+ * (tcc_fault_ev_user()).
+ *
+ * @dev: TCC instance.
+ */
+void init_tcc(tcc_timer dev);
+
+/**
+ * tcc_trigger
+ *
+ * Retrigger (restart) counter.
+ */
+void tcc_trigger(tcc_timer dev);
+
+/**
+ * tcc_stop
+ *
+ * Stop counter.
+ */
+void tcc_stop(tcc_timer dev);
+
+/**
+ * tcc_set_per
+ *
+ * Set period buffer (PERB). New value is applied at next update condition
+ * (period boundary).
+ */
+void tcc_set_per(tcc_timer dev, unsigned int v);
+
+/**
+ * tcc_set_cc
+ *
+ * Set compare buffer (CCBx). New value is applied at next update condition
+ * (period boundary).
+ *
+ * @dev: TCC instance.
+ * @ch: Channel.
+ * @v: Compare value.
+ */
+void tcc_set_cc(tcc_timer dev, int ch, unsigned int v);
+
+/**
+ * tcc_set_patt
+ *
+ * Set pattern generator buffer (PATTB), applied at next update condition.
+ *
+ * @dev: TCC instance.
+ * @en: Outputs overridden by pattern generator.
+ * @val: Output levels.
+ */
+void tcc_set_patt(tcc_timer dev, uint8_t en, uint8_t val);
+
+/**
+ * tcc_lock_update
+ *
+ * Lock buffer update (CTRLB.LUPD). Buffers written after lock are applied
+ * together at first update condition after tcc_unlock_update().
+ */
+void tcc_lock_update(tcc_timer dev);
+
+/**
+ * tcc_unlock_update
+ */
+void tcc_unlock_update(tcc_timer dev);
+
+/**
+ * tcc_fault_ev_user
+ *
+ * Returns: EVSYS user number of fault input.
+ */
+int tcc_fault_ev_user(tcc_timer dev, enum tcc_fault_in f);
+
+/**
+ * tcc_fault_status
+ *
+ * Returns: STATUS fault state and fault input bits (TCC_STATUS_FAULTx,
+ *          TCC_STATUS_FAULTxIN).
+ */
+unsigned int tcc_fault_status(tcc_timer dev);
+
+/**
+ * tcc_fault_clear
+ *
+ * Clear fault state (software halt of recoverable fault or non-recoverable
+ * fault). Fault input must be inactive.
+ *
+ * @dev: TCC instance.
+ * @mask: TCC_STATUS_FAULTA, TCC_STATUS_FAULTB, TCC_STATUS_FAULT0, TCC_STATUS_FAULT1.
+ */
+void tcc_fault_clear(tcc_timer dev, unsigned int mask);
+
+/**
+ * tcc_enable_intr
+ */
+inline void tcc_enable_intr(tcc_timer dev, unsigned int mask)
+{
+	dev->mmio->INTENSET.reg = mask;
+}
+
+/**
+ * tcc_disable_intr
+ */
+inline void tcc_disable_intr(tcc_timer dev, unsigned int mask)
+{
+	dev->mmio->INTENCLR.reg = mask;
+        dev->mmio->INTFLAG.reg = mask;
+}
+
+/**
+ * tcc_clear_intr
+ */
+inline void tcc_clear_intr(tcc_timer dev, unsigned int mask)
+{
+        dev->mmio->INTFLAG.reg = mask;
+}
+#endif
+
+#endif
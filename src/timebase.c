@@ -0,0 +1,134 @@
+/*
+ * timebase.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "tc.h"
+#include "timebase.h"
+
+#if TIMEBASE == 1
+
+static struct tc_timer_dsc tc;
+static volatile uint32_t hi;
+static unsigned int freq;
+static unsigned int tpu;
+
+static BaseType_t isr_clbk(void *dev);
+
+/**
+ * init_timebase
+ */
+void init_timebase(void)
+{
+	tc.id = TIMEBASE_TC_ID;
+	tc.clk_gen = TIMEBASE_GCLK_ID;
+	tc.clock_freq = TIMEBASE_GCLK_FREQ;
+	tc.cnt_size = TC_CNT_SIZE_32_BIT;
+	tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	tc.prescaler = TIMEBASE_PRESC;
+	freq = tc_tick_freq(&tc);
+	tpu = (freq % 1000000 == 0) ? freq / 1000000 : 0;
+	tc.wavegen = TC_WAVEGEN_NFRQ;
+	tc.direction = TC_DIRECTION_UP;
+	tc.int_enable_mask = TC_INTENSET_OVF;
+	tc.isr_clbk = isr_clbk;
+	tc.cnt_rcont = TRUE;
+	init_tc(&tc);
+}
+
+/**
+ * timebase_cnt
+ */
+uint32_t timebase_cnt(void)
+{
+	return (tc.mmio->COUNT32.COUNT.reg);
+}
+
+/**
+ * timebase_now
+ */
+uint64_t timebase_now(void)
+{
+	UBaseType_t m;
+	uint32_t h, l;
+
+	m = taskENTER_CRITICAL_FROM_ISR();
+	h = hi;
+	l = tc.mmio->COUNT32.COUNT.reg;
+	if (tc.mmio->COUNT32.INTFLAG.reg & TC_INTFLAG_OVF && l < 0x80000000) {
+		// Overflow not serviced yet (COUNT can lag behind OVF flag by sync delay).
+		h++;
+	}
+	taskEXIT_CRITICAL_FROM_ISR(m);
+	return ((uint64_t) h << 32 | l);
+}
+
+/**
+ * timebase_now_us
+ */
+uint64_t timebase_now_us(void)
+{
+	return (timebase_ticks_to_us(timebase_now()));
+}
+
+/**
+ * timebase_ticks_to_us
+ */
+uint64_t timebase_ticks_to_us(uint64_t t)
+{
+	if (tpu) {
+		return ((tpu == 1) ? t : t / tpu);
+	}
+	return (t / freq * 1000000 + t % freq * 1000000 / freq);
+}
+
+/**
+ * timebase_us_to_ticks
+ */
+uint64_t timebase_us_to_ticks(uint64_t us)
+{
+	if (tpu) {
+		return (us * tpu);
+	}
+	return (us / 1000000 * freq + us % 1000000 * freq / 1000000);
+}
+
+/**
+ * timebase_freq
+ */
+unsigned int timebase_freq(void)
+{
+	return (freq);
+}
+
+/**
+ * isr_clbk
+ */
+static BaseType_t isr_clbk(void *dev)
+{
+	tc_clear_ovf_intr((tc_timer) dev);
+	hi++;
+	return (pdFALSE);
+}
+
+#endif
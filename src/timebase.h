@@ -0,0 +1,85 @@
+/*
+ * timebase.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#ifndef TIMEBASE
+ #define TIMEBASE 0
+#endif
+#ifndef TIMEBASE_PRESC
+ #define TIMEBASE_PRESC TC_PRESCALER_DIV1
+#endif
+
+#if TIMEBASE == 1
+
+#include "tc.h"
+
+/**
+ * init_timebase
+ *
+ * Start free-running 32-bit counter (cascaded TC pair TIMEBASE_TC_ID,
+ * i.e. ID_TC4 or ID_TC6) clocked from GCLK TIMEBASE_GCLK_ID and extended
+ * to 64 bits by overflow interrupt. COUNT is read continuously (RCONT).
+ */
+void init_timebase(void);
+
+/**
+ * timebase_cnt
+ *
+ * Returns: Lower 32 bits of timebase (for short interval measurement).
+ */
+uint32_t timebase_cnt(void);
+
+/**
+ * timebase_now
+ *
+ * Get 64-bit timebase value (can be called from task and ISR).
+ *
+ * Returns: Timebase ticks.
+ */
+uint64_t timebase_now(void);
+
+/**
+ * timebase_now_us
+ *
+ * Get time since init_timebase() (can be called from task and ISR).
+ *
+ * Returns: Time in microseconds.
+ */
+uint64_t timebase_now_us(void);
+
+/**
+ * timebase_ticks_to_us
+ */
+uint64_t timebase_ticks_to_us(uint64_t t);
+
+/**
+ * timebase_us_to_ticks
+ */
+uint64_t timebase_us_to_ticks(uint64_t us);
+
+/**
+ * timebase_freq
+ *
+ * Returns: Timebase frequency in Hz.
+ */
+unsigned int timebase_freq(void);
+#endif
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * tmwheel.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "msgconf.h"
+#include "criterr.h"
+#include "tc.h"
+#include "tmwheel.h"
+
+#if TMWHEEL == 1
+
+#if TMWHEEL_SLOTS % 32 != 0 || (TMWHEEL_SLOTS & (TMWHEEL_SLOTS - 1)) != 0
+ #error "TMWHEEL_SLOTS must be power of two and multiple of 32"
+#endif
+
+#define SLOT_TICKS (1UL << TMWHEEL_SLOT_SHIFT)
+#define SLOT_MASK (TMWHEEL_SLOTS - 1)
+#define SPAN ((uint32_t) TMWHEEL_SLOTS << TMWHEEL_SLOT_SHIFT)
+#define SLOT(t) (((t) >> TMWHEEL_SLOT_SHIFT) & SLOT_MASK)
+// Deadlines closer than CMP_MARGIN ticks are served immediately (COUNT read lags).
+#define CMP_MARGIN 16
+
+enum {
+	TMR_IDLE,
+	TMR_ARMED,
+	TMR_FIRE,
+	TMR_PEND
+};
+
+static struct tc_timer_dsc tc;
+static tmwheel_tmr slot[TMWHEEL_SLOTS];
+static uint32_t map[TMWHEEL_SLOTS / 32];
+static tmwheel_tmr dfr;
+static int armed_cnt;
+static uint32_t last;
+static uint32_t cc;
+static boolean_t cc_act;
+static unsigned int freq;
+static unsigned int irq_cnt, isr_cnt, dfr_cnt, max_armed;
+static TaskHandle_t tsk_hndl;
+static const char *const tsk_nm = "TMWHEEL";
+
+static void tmwheel_tsk(void *p);
+static BaseType_t isr_clbk(void *dev);
+static void arm(tmwheel_tmr t, uint32_t exp);
+static void disarm(tmwheel_tmr t);
+static void set_cmp(uint32_t v);
+static void prog_next(uint32_t n);
+static inline uint32_t now(void);
+static inline void link(tmwheel_tmr t, tmwheel_tmr *head);
+static inline void unlink(tmwheel_tmr t);
+
+/**
+ * init_tmwheel
+ */
+void init_tmwheel(void)
+{
+	if (pdPASS != xTaskCreate(tmwheel_tsk, tsk_nm, TMWHEEL_TASK_STACK_SIZE, NULL,
+				  TMWHEEL_TASK_PRIO, &tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	tc.id = TMWHEEL_TC_ID;
+	tc.clk_gen = TMWHEEL_GCLK_ID;
+	tc.clock_freq = TMWHEEL_GCLK_FREQ;
+	tc.cnt_size = TC_CNT_SIZE_32_BIT;
+	tc.cnt_sync = TC_CNT_SYNC_PRESC;
+	tc.prescaler = TMWHEEL_PRESC;
+	freq = tc_tick_freq(&tc);
+	tc.wavegen = TC_WAVEGEN_NFRQ;
+	tc.direction = TC_DIRECTION_UP;
+	tc.isr_clbk = isr_clbk;
+	tc.cnt_rcont = TRUE;
+	init_tc(&tc);
+}
+
+/**
+ * tmwheel_start
+ */
+void tmwheel_start(tmwheel_tmr t, uint32_t ticks)
+{
+	UBaseType_t m;
+
+	if (ticks & 0x80000000) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	m = taskENTER_CRITICAL_FROM_ISR();
+	disarm(t);
+	arm(t, now() + ticks);
+	taskEXIT_CRITICAL_FROM_ISR(m);
+}
+
+/**
+ * tmwheel_start_at
+ */
+void tmwheel_start_at(tmwheel_tmr t, uint32_t exp)
+{
+	UBaseType_t m;
+
+	m = taskENTER_CRITICAL_FROM_ISR();
+	disarm(t);
+	arm(t, exp);
+	taskEXIT_CRITICAL_FROM_ISR(m);
+}
+
+/**
+ * tmwheel_cancel
+ */
+boolean_t tmwheel_cancel(tmwheel_tmr t)
+{
+	UBaseType_t m;
+	boolean_t act;
+
+	m = taskENTER_CRITICAL_FROM_ISR();
+	act = (t->state != TMR_IDLE) ? TRUE : FALSE;
+	disarm(t);
+	taskEXIT_CRITICAL_FROM_ISR(m);
+	return (act);
+}
+
+/**
+ * tmwheel_active
+ */
+boolean_t tmwheel_active(tmwheel_tmr t)
+{
+	return ((t->state != TMR_IDLE) ? TRUE : FALSE);
+}
+
+/**
+ * tmwheel_now
+ */
+uint32_t tmwheel_now(void)
+{
+	return (now());
+}
+
+/**
+ * tmwheel_us_to_ticks
+ */
+uint32_t tmwheel_us_to_ticks(uint32_t us)
+{
+	return ((unsigned long long) us * freq / 1000000);
+}
+
+/**
+ * arm
+ */
+static void arm(tmwheel_tmr t, uint32_t exp)
+{
+	int s;
+
+	if (!armed_cnt) {
+		last = now();
+	}
+	// Late expiry goes to slot which will be walked next.
+	s = ((int32_t) (exp - last) < 0) ? SLOT(last) : SLOT(exp);
+	t->exp = exp;
+	t->slot = s;
+	t->state = TMR_ARMED;
+	link(t, &slot[s]);
+	map[s >> 5] |= 1UL << (s & 31);
+	if (++armed_cnt > (int) max_armed) {
+		max_armed = armed_cnt;
+	}
+	if (!cc_act || (int32_t) (exp - cc) < 0) {
+		set_cmp(exp);
+	}
+}
+
+/**
+ * disarm
+ */
+static void disarm(tmwheel_tmr t)
+{
+	int s;
+
+	switch (t->state) {
+	case TMR_ARMED :
+		s = t->slot;
+		unlink(t);
+		if (!slot[s]) {
+			map[s >> 5] &= ~(1UL << (s & 31));
+		}
+		armed_cnt--;
+		// Compare stays programmed, spurious interrupt only reschedules.
+		break;
+	case TMR_FIRE  :
+	case TMR_PEND  :
+		unlink(t);
+		break;
+	default        :
+		break;
+	}
+	t->state = TMR_IDLE;
+}
+
+/**
+ * set_cmp
+ */
+static void set_cmp(uint32_t v)
+{
+	cc = v;
+	cc_act = TRUE;
+	tc_set_cc0(&tc, v);
+	tc_enable_mc0_intr(&tc);
+	if ((int32_t) (v - now()) <= CMP_MARGIN) {
+		// Match could be missed while CC0 was synchronized.
+		NVIC_SetPendingIRQ(tc.irqn);
+	}
+}
+
+/**
+ * prog_next
+ *
+ * Find nearest deadline. Slots are scanned from current one, only timers
+ * in current wheel round are taken into account. If no such timer exists,
+ * wake up after one wheel revolution.
+ */
+static void prog_next(uint32_t n)
+{
+	uint32_t base, w, min = 0;
+	int i, s;
+	boolean_t fnd = FALSE;
+
+	if (!armed_cnt) {
+		cc_act = FALSE;
+		tc_disable_mc0_intr(&tc);
+		return;
+	}
+	base = n & ~(SLOT_TICKS - 1);
+	for (i = 0; i < TMWHEEL_SLOTS && !fnd; ) {
+		s = (SLOT(n) + i) & SLOT_MASK;
+		w = map[s >> 5] >> (s & 31);
+		if (!w) {
+			i += 32 - (s & 31);
+			continue;
+		}
+		if (w & 1) {
+			for (tmwheel_tmr t = slot[s]; t; t = t->next) {
+				if ((int) ((t->exp - base) >> TMWHEEL_SLOT_SHIFT) == i &&
+				    (!fnd || (int32_t) (t->exp - min) < 0)) {
+					min = t->exp;
+					fnd = TRUE;
+				}
+			}
+		}
+		i++;
+	}
+	set_cmp((fnd) ? min : base + SPAN);
+}
+
+/**
+ * tmwheel_tsk
+ */
+static void tmwheel_tsk(void *p)
+{
+	tmwheel_tmr t;
+
+	while (TRUE) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while (TRUE) {
+			taskENTER_CRITICAL();
+			if (NULL != (t = dfr)) {
+				unlink(t);
+				t->state = TMR_IDLE;
+			}
+			taskEXIT_CRITICAL();
+			if (!t) {
+				break;
+			}
+			t->clbk(t->arg);
+			dfr_cnt++;
+		}
+	}
+}
+
+/**
+ * isr_clbk
+ */
+static BaseType_t isr_clbk(void *dev)
+{
+	BaseType_t tsk_wkn = pdFALSE;
+	tmwheel_tmr t, nx, fire = NULL;
+	uint32_t n, k;
+	int s;
+	boolean_t ntf = FALSE;
+
+	tc_clear_mc0_intr((tc_timer) dev);
+	irq_cnt++;
+	n = now();
+	// Walk slots passed since last run.
+	k = (n + CMP_MARGIN - (last & ~(SLOT_TICKS - 1))) >> TMWHEEL_SLOT_SHIFT;
+	if (k >= TMWHEEL_SLOTS) {
+		k = TMWHEEL_SLOTS - 1;
+	}
+	for (uint32_t i = 0; i <= k; i++) {
+		s = (SLOT(last) + i) & SLOT_MASK;
+		for (t = slot[s]; t; t = nx) {
+			nx = t->next;
+			if ((int32_t) (t->exp - n) > CMP_MARGIN) {
+				continue;
+			}
+			unlink(t);
+			armed_cnt--;
+			if (t->isr) {
+				t->state = TMR_FIRE;
+				link(t, &fire);
+			} else {
+				t->state = TMR_PEND;
+				link(t, &dfr);
+				ntf = TRUE;
+			}
+		}
+		if (!slot[s]) {
+			map[s >> 5] &= ~(1UL << (s & 31));
+		}
+	}
+	last = n;
+	// Callbacks can restart or cancel any timer including those in fire list.
+	while (NULL != (t = fire)) {
+		unlink(t);
+		t->state = TMR_IDLE;
+		if (t->clbk(t->arg)) {
+			tsk_wkn = pdTRUE;
+		}
+		isr_cnt++;
+	}
+	if (ntf) {
+		vTaskNotifyGiveFromISR(tsk_hndl, &tsk_wkn);
+	}
+	prog_next(n);
+	return (tsk_wkn);
+}
+
+/**
+ * now
+ */
+static inline uint32_t now(void)
+{
+	return (tc.mmio->COUNT32.COUNT.reg);
+}
+
+/**
+ * link
+ */
+static inline void link(tmwheel_tmr t, tmwheel_tmr *head)
+{
+	if (NULL != (t->next = *head)) {
+		t->next->pprev = &t->next;
+	}
+	t->pprev = head;
+	*head = t;
+}
+
+/**
+ * unlink
+ */
+static inline void unlink(tmwheel_tmr t)
+{
+	if (NULL != (*t->pprev = t->next)) {
+		t->next->pprev = t->pprev;
+	}
+}
+
+#if TERMOUT == 1
+/**
+ * log_tmwheel_stats
+ */
+void log_tmwheel_stats(void)
+{
+	msg(INF, "tmwheel.c: freq=%u armed=%d max_armed=%u irq=%u isr_clbk=%u dfr_clbk=%u\n",
+	    freq, armed_cnt, max_armed, irq_cnt, isr_cnt, dfr_cnt);
+}
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * tmwheel.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TMWHEEL_H
+#define TMWHEEL_H
+
+#ifndef TMWHEEL
+ #define TMWHEEL 0
+#endif
+#ifndef TMWHEEL_PRESC
+ #define TMWHEEL_PRESC TC_PRESCALER_DIV1
+#endif
+#ifndef TMWHEEL_SLOTS
+ #define TMWHEEL_SLOTS 128
+#endif
+#ifndef TMWHEEL_SLOT_SHIFT
+ #define TMWHEEL_SLOT_SHIFT 13
+#endif
+
+#if TMWHEEL == 1
+
+#include "tc.h"
+
+typedef struct tmwheel_tmr_dsc *tmwheel_tmr;
+
+struct tmwheel_tmr_dsc {
+	BaseType_t (*clbk)(void *arg); // <SetIt>
+	void *arg; // <SetIt>
+	boolean_t isr; // <SetIt> TRUE: clbk runs in ISR, FALSE: clbk runs in TMWHEEL task.
+	uint32_t exp;
+	unsigned short slot;
+	volatile uint8_t state;
+	struct tmwheel_tmr_dsc *next;
+	struct tmwheel_tmr_dsc **pprev;
+};
+
+/**
+ * init_tmwheel
+ *
+ * Start free-running 32-bit counter (cascaded TC pair TMWHEEL_TC_ID,
+ * i.e. ID_TC4 or ID_TC6) clocked from GCLK TMWHEEL_GCLK_ID and create task
+ * for deferred callbacks. Timers are hashed into TMWHEEL_SLOTS buckets of
+ * 2^TMWHEEL_SLOT_SHIFT ticks; CC0 is programmed for the nearest deadline.
+ */
+void init_tmwheel(void);
+
+/**
+ * tmwheel_start
+ *
+ * (Re)start timer. O(1), can be called from task, ISR and timer callback.
+ *
+ * @t: Timer instance.
+ * @ticks: Timeout in counter ticks (less than 2^31).
+ */
+void tmwheel_start(tmwheel_tmr t, uint32_t ticks);
+
+/**
+ * tmwheel_start_at
+ *
+ * (Re)start timer with absolute expiry time. Periodic callbacks use
+ * tmwheel_start_at(t, t->exp + period) to avoid drift.
+ *
+ * @t: Timer instance.
+ * @exp: Expiry time (tmwheel_now() based, less than 2^31 ticks ahead).
+ */
+void tmwheel_start_at(tmwheel_tmr t, uint32_t exp);
+
+/**
+ * tmwheel_cancel
+ *
+ * Stop timer. O(1), can be called from task, ISR and timer callback.
+ * Deferred callback already taken by TMWHEEL task cannot be cancelled.
+ *
+ * @t: Timer instance.
+ *
+ * Returns: TRUE - timer was pending; FALSE - timer was idle.
+ */
+boolean_t tmwheel_cancel(tmwheel_tmr t);
+
+/**
+ * tmwheel_active
+ *
+ * Returns: TRUE - timer is armed or its deferred callback is pending.
+ */
+boolean_t tmwheel_active(tmwheel_tmr t);
+
+/**
+ * tmwheel_now
+ *
+ * Returns: Counter value (wraps at 2^32).
+ */
+uint32_t tmwheel_now(void);
+
+/**
+ * tmwheel_us_to_ticks
+ */
+uint32_t tmwheel_us_to_ticks(uint32_t us);
+
+#if TERMOUT == 1
+/**
+ * log_tmwheel_stats
+ */
+void log_tmwheel_stats(void);
+#endif
+#endif
+
+#endif
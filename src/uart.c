@@ -210,7 +210,7 @@ void init_uart(uart dev, enum uart_mode m)
 	NVIC_DisableIRQ(dev->irqn);
         enable_clk_channel(dev->clk_chn, dev->clk_gen);
         enable_per_apb_clk(dev->apb_bus_ins, dev->apb_mask);
-	reg_sercom_isr_clbk(dev->id, rx_char_hndlr, dev);
+	reg_sercom_pers(dev->id, rx_char_hndlr, enable_uart, disable_uart, dev);
 	dev->mmio->CTRLA.reg = SERCOM_USART_CTRLA_SWRST;
 	while (dev->mmio->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_SWRST);
         NVIC_SetPriority(dev->irqn, configLIBRARY_API_CALL_INTERRUPT_PRIORITY);
@@ -236,7 +236,7 @@ void enable_uart(void *dev)
 	uint16_t u16;
         uint8_t u8;
 
-        re_enable_clk_channel(((uart) dev)->clk_chn);
+        enable_clk_channel(((uart) dev)->clk_chn, ((uart) dev)->clk_gen);
         enable_per_apb_clk(((uart) dev)->apb_bus_ins, ((uart) dev)->apb_mask);
 	((uart) dev)->mmio->CTRLA.reg = SERCOM_USART_CTRLA_SWRST;
 	while (((uart) dev)->mmio->SYNCBUSY.reg & SERCOM_USART_SYNCBUSY_SWRST);
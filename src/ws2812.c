@@ -0,0 +1,127 @@
+/*
+ * ws2812.c
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <semphr.h>
+#include <queue.h>
+#include <gentyp.h>
+#include "sysconf.h"
+#include "board.h"
+#include <mmio.h>
+#include "criterr.h"
+#include "hwerr.h"
+#include "pm.h"
+#include "gclk.h"
+#include "dmac.h"
+#include "spi.h"
+#include "ws2812.h"
+
+#if WS2812 == 1
+
+static uint32_t lut[256];
+
+static void ws2812_tsk(void *p);
+
+/**
+ * init_ws2812
+ */
+void init_ws2812(ws2812 dev)
+{
+	uint32_t v;
+
+	if (dev->spi == NULL || !dev->spi->dma || dev->pix == NULL ||
+	    dev->enc[0] == NULL || dev->enc[1] == NULL) {
+		crit_err_exit(BAD_PARAMETER);
+	}
+	if (!lut[0]) {
+		for (int b = 0; b < 256; b++) {
+			v = 0;
+			for (int i = 7; i >= 0; i--) {
+				v = v << 4 | ((b & 1 << i) ? 0xE : 0x8);
+			}
+			lut[b] = v >> 24 | (v >> 8 & 0xFF00) | (v << 8 & 0xFF0000) | v << 24;
+		}
+	}
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < WS2812_RESET_WORDS; j++) {
+			dev->enc[i][j] = 0;
+		}
+	}
+	dev->back = 0;
+	if (NULL == (dev->idle = xSemaphoreCreateBinary())) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+	xSemaphoreGive(dev->idle);
+	if (pdPASS != xTaskCreate(ws2812_tsk, dev->tsk_nm, WS2812_TASK_STACK_SIZE, dev,
+				  WS2812_TASK_PRIO, &dev->tsk_hndl)) {
+		crit_err_exit(MALLOC_ERROR);
+	}
+}
+
+/**
+ * ws2812_set
+ */
+void ws2812_set(ws2812 dev, int i, uint8_t r, uint8_t g, uint8_t b)
+{
+	dev->pix[3 * i] = g;
+	dev->pix[3 * i + 1] = r;
+	dev->pix[3 * i + 2] = b;
+}
+
+/**
+ * ws2812_show
+ */
+int ws2812_show(ws2812 dev, TickType_t tmo)
+{
+	uint32_t *p = dev->enc[dev->back] + WS2812_RESET_WORDS;
+	int n = 3 * dev->led_cnt, err;
+
+	for (int i = 0; i < n; i++) {
+		p[i] = lut[dev->pix[i]];
+	}
+	if (pdTRUE != xSemaphoreTake(dev->idle, tmo)) {
+		return (-ETMO);
+	}
+	err = dev->err;
+	dev->err = 0;
+	xTaskNotify(dev->tsk_hndl, dev->back, eSetValueWithOverwrite);
+	dev->back ^= 1;
+	return (err);
+}
+
+/**
+ * ws2812_tsk
+ */
+static void ws2812_tsk(void *p)
+{
+	ws2812 dev = p;
+	uint32_t buf;
+	int err;
+
+	while (TRUE) {
+		xTaskNotifyWait(0, 0, &buf, portMAX_DELAY);
+		if ((err = spi_transfer(dev->spi, dev->enc[buf], NULL, 4 * WS2812_ENC_WORDS(dev->led_cnt)))) {
+			dev->err = err;
+		}
+		dev->frame_cnt++;
+		xSemaphoreGive(dev->idle);
+	}
+}
+
+#endif
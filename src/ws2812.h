@@ -0,0 +1,94 @@
+/*
+ * ws2812.h
+ *
+ * Copyright (c) 2024 Jan Rusnak <jan@rusnak.sk>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef WS2812_H
+#define WS2812_H
+
+#ifndef WS2812
+ #define WS2812 0
+#endif
+#ifndef WS2812_RESET_WORDS
+ #define WS2812_RESET_WORDS 30
+#endif
+
+#if WS2812 == 1
+
+#include "spi.h"
+
+/**
+ * WS2812_ENC_WORDS
+ *
+ * Size of encoded frame buffer in 32-bit words (leading reset gap plus
+ * 4 SPI bits per LED data bit).
+ */
+#define WS2812_ENC_WORDS(led_cnt) (WS2812_RESET_WORDS + 3 * (led_cnt))
+
+typedef struct ws2812_dsc *ws2812;
+
+struct ws2812_dsc {
+	spi spi; // <SetIt> - SPI master (DMA, MSB first, 8-bit chars, SCK approx. 3.2 MHz).
+	int led_cnt; // <SetIt>
+	uint8_t *pix; // <SetIt> - Pixels in GRB order (3 * led_cnt bytes).
+	uint32_t *enc[2]; // <SetIt> - Encoded frames (WS2812_ENC_WORDS(led_cnt) words each).
+	const char *tsk_nm; // <SetIt>
+	TaskHandle_t tsk_hndl;
+	SemaphoreHandle_t idle;
+	int back;
+	int err;
+	unsigned int frame_cnt;
+};
+
+/**
+ * init_ws2812
+ *
+ * Initialize LED strip instance and create its output task.
+ *
+ * @dev: LED strip instance.
+ */
+void init_ws2812(ws2812 dev);
+
+/**
+ * ws2812_set
+ *
+ * Set pixel color in pixel buffer.
+ *
+ * @dev: LED strip instance.
+ * @i: LED index.
+ * @r: Red.
+ * @g: Green.
+ * @b: Blue.
+ */
+void ws2812_set(ws2812 dev, int i, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * ws2812_show
+ *
+ * Encode pixel buffer to back frame buffer (while previous frame is being
+ * sent by DMA), wait for end of previous frame and start output of new
+ * frame. Pixel buffer can be modified after return.
+ *
+ * @dev: LED strip instance.
+ * @tmo: Timeout for previous frame in ticks.
+ *
+ * Returns: 0 - success; -ETMO - previous frame not finished;
+ *   -EDMA - dma error of previous frame.
+ */
+int ws2812_show(ws2812 dev, TickType_t tmo);
+#endif
+
+#endif